@@ -4,15 +4,25 @@
 #include "types.h"
 #include "mapping.h"
 #include "debugutils.h"
+#include "morton.h"
+#include "isa.h"
 
 #include <limits>
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <type_traits>
 #include <math.h>
 #include <cmath>
+#include <unistd.h>
 
 // #define VORTEX_RADIUS 1e-5
 #define VORTEX_RADIUS 1.e-6
 #define VORTEX_RADIUS_SQ 1e-4
 #define EPSILON_VORTEX 1e-10
+// sine of the angle between a segment and the direction to the target
+// below which a single precision kernel evaluation is redone in double
+#define SINGLE_PRECISION_COLLINEAR 1e-2
 #define Nvert 4
 
 // Declaration for parallel computing
@@ -35,7 +45,7 @@ namespace UVLM
             const t_tsurface&   target_surface,
             t_uout&             uout,
             // const UVLM::Types::IntPair& dimensions,
-            const bool&         image_method = false,
+            const UVLM::Types::MirrorImages& images = UVLM::Types::MirrorImages(),
             const t_normals&    normal = NULL,
             // const bool&         horseshoe = false,
             const UVLM::Types::Real vortex_radius = VORTEX_RADIUS
@@ -57,7 +67,7 @@ namespace UVLM
             const t_tsurface&   target_surface,
             const bool&         horseshoe,
             t_uout&             uout,
-            const bool&         image_method = false,
+            const UVLM::Types::MirrorImages& images = UVLM::Types::MirrorImages(),
             const t_normals&    normal = NULL,
             const UVLM::Types::Real vortex_radius = VORTEX_RADIUS
         );
@@ -77,7 +87,7 @@ namespace UVLM
             const t_gamma_star& gamma_star,
             const t_tsurface&   target_surface,
             t_uout&             uout,
-            const bool&         image_method,
+            const UVLM::Types::MirrorImages& images,
             const t_normals&    normal,
             const int&          n_rows = -1
         );
@@ -96,7 +106,7 @@ namespace UVLM
             unsigned int        Nstart = 0,
             unsigned int        Mend   = -1,
             unsigned int        Nend   = -1,
-            const bool&         image_method = false,
+            const UVLM::Types::MirrorImages& images = UVLM::Types::MirrorImages(),
             const UVLM::Types::Real vortex_radius = VORTEX_RADIUS
         );
 
@@ -115,7 +125,7 @@ namespace UVLM
             const t_ttriad&     target_triad,
             const bool&         horseshoe,
             t_uout&             uout,
-            const bool&         image_method = false,
+            const UVLM::Types::MirrorImages& images = UVLM::Types::MirrorImages(),
             const UVLM::Types::Real vortex_radius = VORTEX_RADIUS
         );
 
@@ -133,10 +143,41 @@ namespace UVLM
             const t_gamma_star& gamma_star,
             const t_ttriad&     target_triad,
             t_uout&             uout,
-            const bool&         image_method,
+            const UVLM::Types::MirrorImages& images,
             const int&          n_rows = -1 // default val = -1
         );
 
+        template <typename t_zeta_star,
+                  typename t_gamma_star,
+                  typename t_ttriad,
+                  typename t_uout>
+        void steady_wake
+        (
+            const t_zeta_star&  zeta_star,
+            const t_gamma_star& gamma_star,
+            const t_ttriad&     target_triad,
+            const bool&         horseshoe,
+            t_uout&             uout,
+            const uint&         i_row,
+            const UVLM::Types::MirrorImages& images = UVLM::Types::MirrorImages(),
+            const UVLM::Types::Real vortex_radius = VORTEX_RADIUS
+        );
+
+        template <typename t_zeta_star,
+                  typename t_gamma_star,
+                  typename t_ttriad,
+                  typename t_uout>
+        void unsteady_wake
+        (
+            const t_zeta_star&  zeta_star,
+            const t_gamma_star& gamma_star,
+            const t_ttriad&     target_triad,
+            t_uout&             uout,
+            const uint&         i_row,
+            const UVLM::Types::MirrorImages& images,
+            const int&          n_rows = -1
+        );
+
         template <typename t_triad,
                   typename t_block>
                   //typename t_uind>
@@ -148,6 +189,7 @@ namespace UVLM
             const t_block& z,
             const UVLM::Types::Real& gamma_star,
             // t_uind& uind,
+            const UVLM::Types::MirrorImages& images = UVLM::Types::MirrorImages(),
             const UVLM::Types::Real vortex_radius = VORTEX_RADIUS
         );
 
@@ -161,6 +203,7 @@ namespace UVLM
             const t_block& z,
             const UVLM::Types::Real& gamma,
             UVLM::Types::Vector3& uind,
+            const UVLM::Types::MirrorImages& images = UVLM::Types::MirrorImages(),
             const UVLM::Types::Real vortex_radius = VORTEX_RADIUS
         );
 
@@ -176,6 +219,311 @@ namespace UVLM
             const UVLM::Types::Real vortex_radius = VORTEX_RADIUS
         );
 
+        // t_real is the working precision (double, or float for the
+        // single precision evaluation of the segment tables)
+        template <typename t_real>
+        Eigen::Matrix<t_real, 3, 1> segment_kernel
+        (
+            const t_real r0[3],
+            const t_real r1[3],
+            const t_real r2[3],
+            const t_real& gamma
+        );
+
+        template <typename t_real>
+        Eigen::Matrix<t_real, 3, 1> segment_kernel
+        (
+            const t_real r0[3],
+            const t_real r1[3],
+            const t_real r2[3],
+            const t_real r1_mod,
+            const t_real r2_mod,
+            const t_real& gamma
+        );
+
+        // segment_kernel and its gradient with respect to the target,
+        // added to uind and to grad[3*i + j] = d uind(i)/d x(j)
+        void segment_gradient_kernel
+        (
+            const UVLM::Types::Real r0[3],
+            const UVLM::Types::Real r1[3],
+            const UVLM::Types::Real r2[3],
+            const UVLM::Types::Real& gamma,
+            UVLM::Types::Real uind[3],
+            UVLM::Types::Real grad[9]
+        );
+
+        // true if the target at r1 from the start of the segment r0 is
+        // close to the line of the segment (sine of the angle between r0
+        // and r1 below SINGLE_PRECISION_COLLINEAR)
+        template <typename t_real>
+        bool is_collinear
+        (
+            const t_real r0[3],
+            const t_real r1[3]
+        );
+
+        // segment plus its mirror images, evaluated together
+        template <typename t_triad>
+        UVLM::Types::Vector3 segment
+        (
+            const t_triad& target_triad,
+            const UVLM::Types::Vector3& v1,
+            const UVLM::Types::Vector3& v2,
+            const UVLM::Types::Real& gamma,
+            const UVLM::Types::MirrorImages& images
+        );
+
+        // Compile-time variants of the kernels: the number of mirror images
+        // and the horseshoe flag are template parameters, so the inner loops
+        // carry no runtime tests. The runtime functions above resolve the
+        // flags and the Mend/Nend == -1 sentinels once per call and select
+        // the variant with with_images and with_flag, which call function
+        // with a std::integral_constant.
+        template <typename t_function>
+        void with_images
+        (
+            const uint n_images,
+            t_function function
+        );
+
+        template <typename t_function>
+        void with_flag
+        (
+            const bool flag,
+            t_function function
+        );
+
+        template <uint n_images,
+                  typename t_triad>
+        UVLM::Types::Vector3 image_segment
+        (
+            const t_triad& target_triad,
+            const UVLM::Types::Vector3& v1,
+            const UVLM::Types::Vector3& v2,
+            const UVLM::Types::Real& gamma,
+            const UVLM::Types::MirrorImages& images
+        );
+
+        template <uint n_images,
+                  typename t_triad,
+                  typename t_block>
+        UVLM::Types::Vector3 vortex_ring_kernel
+        (
+            const t_triad& target_triad,
+            const t_block& x,
+            const t_block& y,
+            const t_block& z,
+            const UVLM::Types::Real& gamma,
+            const UVLM::Types::MirrorImages& images
+        );
+
+        template <uint n_images,
+                  typename t_zeta,
+                  typename t_gamma,
+                  typename t_ttriad,
+                  typename t_uout>
+        void surface_kernel
+        (
+            const t_zeta&       zeta,
+            const t_gamma&      gamma,
+            const t_ttriad&     target_triad,
+            t_uout&             uout,
+            const uint          Mstart,
+            const uint          Nstart,
+            const uint          Mend,
+            const uint          Nend,
+            const UVLM::Types::MirrorImages& images
+        );
+
+        template <uint n_images,
+                  bool horseshoe,
+                  typename t_zeta_star,
+                  typename t_gamma_star,
+                  typename t_ttriad,
+                  typename t_uout>
+        void steady_wake_kernel
+        (
+            const t_zeta_star&  zeta_star,
+            const t_gamma_star& gamma_star,
+            const t_ttriad&     target_triad,
+            t_uout&             uout,
+            const uint          i_row,
+            const UVLM::Types::MirrorImages& images
+        );
+
+        template <uint n_images,
+                  typename t_zeta,
+                  typename t_gamma,
+                  typename t_ttriad>
+        UVLM::Types::Vector3 whole_surface_kernel
+        (
+            const t_zeta&       zeta,
+            const t_gamma&      gamma,
+            const t_ttriad&     target_triad,
+            const uint          Mstart,
+            const uint          Nstart,
+            const uint          Mend,
+            const uint          Nend,
+            const UVLM::Types::MirrorImages& images
+        );
+
+        // Tile sizes of the target x segment evaluation, from the data cache
+        // sizes of the machine: a tile of segments stays in L1 while it is
+        // swept by all the targets of a tile, whose coordinates and
+        // velocities stay in L2.
+        struct CacheTiles
+        {
+            uint segments;
+            uint targets;
+        };
+
+        const CacheTiles& cache_tiles();
+
+        // Vortex segments of a set of lattices as flat arrays: every unique
+        // edge is stored once with its start point, direction (end - start)
+        // and effective circulation (the difference of the circulations of
+        // the rings that share it). It is built once for a geometry and
+        // circulation distribution and then evaluated for every target.
+        // Edges without net circulation (the spanwise edges of a steady
+        // wake, or the trailing edge when the first wake row has the
+        // circulation of the last bound row) are dropped.
+        class SegmentTable
+        {
+        public:
+            template <typename t_zeta,
+                      typename t_gamma>
+            void add_surface
+            (
+                const t_zeta& zeta,
+                const t_gamma& gamma
+            );
+
+            // bound lattice and its wake, the trailing edge and the first
+            // wake row are merged when they coincide
+            template <typename t_zeta,
+                      typename t_zeta_star,
+                      typename t_gamma,
+                      typename t_gamma_star>
+            void add_surface
+            (
+                const t_zeta& zeta,
+                const t_zeta_star& zeta_star,
+                const t_gamma& gamma,
+                const t_gamma_star& gamma_star
+            );
+
+            template <typename t_ttriad>
+            UVLM::Types::Vector3 induced_velocity
+            (
+                const t_ttriad& target_triad,
+                const UVLM::Types::MirrorImages& images = UVLM::Types::MirrorImages()
+            ) const;
+
+            // velocities induced at the rows of targets (n x 3), added to
+            // the rows of uout, evaluated by cache tiles of targets and
+            // segments
+            template <typename t_targets,
+                      typename t_uout>
+            void induced_velocities
+            (
+                const t_targets& targets,
+                t_uout& uout,
+                const UVLM::Types::MirrorImages& images = UVLM::Types::MirrorImages()
+            ) const;
+
+            // induced_velocities (in double precision) plus the velocity
+            // gradients, added to the rows of gradients (n x 9) as
+            // d u(i)/d x(j) in the column 3*i + j
+            template <typename t_targets,
+                      typename t_uout,
+                      typename t_gradients>
+            void induced_velocities_and_gradients
+            (
+                const t_targets& targets,
+                t_uout& uout,
+                t_gradients& gradients,
+                const UVLM::Types::MirrorImages& images = UVLM::Types::MirrorImages()
+            ) const;
+
+            // as above for the vertices of a lattice, added to u_ind
+            template <typename t_zeta_col,
+                      typename t_u_ind>
+            void induced_velocities_on_surface
+            (
+                const t_zeta_col& zeta_col,
+                t_u_ind& u_ind,
+                const UVLM::Types::MirrorImages& images = UVLM::Types::MirrorImages()
+            ) const;
+
+            // keeps a single precision copy of the segments, with which
+            // induced_velocities evaluates the kernel in float (the
+            // velocities are still accumulated in double)
+            void use_single_precision();
+
+            // sorts the segments by the Morton code of their midpoints;
+            // the targets of induced_velocities are then evaluated in
+            // Morton order too, and the results mapped back to their rows
+            void sort_morton();
+
+            uint size() const {return circulation.size();}
+            void clear();
+
+        private:
+            bool morton_order = false;
+            std::vector<UVLM::Types::Real> x, y, z;
+            std::vector<UVLM::Types::Real> dx, dy, dz;
+            std::vector<UVLM::Types::Real> circulation;
+            // the 7 columns above one after the other, in single precision
+            // and with the end points instead of the directions
+            std::vector<float> single_columns;
+
+            template <typename t_zeta>
+            void add_segment
+            (
+                const t_zeta& zeta,
+                const uint i_start,
+                const uint j_start,
+                const uint i_end,
+                const uint j_end,
+                const UVLM::Types::Real segment_circulation
+            );
+
+            template <typename t_zeta,
+                      typename t_gamma>
+            void add_lattice
+            (
+                const t_zeta& zeta,
+                const t_gamma& gamma,
+                const bool leading_edge,
+                const bool trailing_edge
+            );
+
+            UVLM::Types::Vector3 velocity
+            (
+                const UVLM::Types::Vector3& target
+            ) const;
+
+            // order of evaluation of the rows of targets: Morton order
+            // if the segments are sorted, otherwise the rows in sequence
+            template <typename t_targets>
+            std::vector<uint> target_order
+            (
+                const t_targets& targets
+            ) const;
+
+            template <typename t_real,
+                      typename t_targets,
+                      typename t_uout>
+            void evaluate_tiles
+            (
+                const t_real* const columns[7],
+                const t_targets& targets,
+                t_uout& uout,
+                const UVLM::Types::MirrorImages& images
+            ) const;
+        };
+
 
 
         template <typename t_zeta,
@@ -190,7 +538,9 @@ namespace UVLM
             const t_gamma&      gamma,
             const t_gamma_star& gamma_star,
             t_uout&             uout,
-            const bool&         image_method = false,
+            const UVLM::Types::MirrorImages& images = UVLM::Types::MirrorImages(),
+            const bool          morton_order = false,
+            const bool          single_precision = false,
             const UVLM::Types::Real vortex_radius = VORTEX_RADIUS
         );
 
@@ -206,7 +556,7 @@ namespace UVLM
             const t_gamma& gamma,
             const t_zeta_col& zeta_col,
             t_u_ind& u_ind,
-            const bool image_method = false
+            const UVLM::Types::MirrorImages& images = UVLM::Types::MirrorImages()
         );
 
 
@@ -224,7 +574,20 @@ namespace UVLM
             unsigned int        Nstart = 0,
             unsigned int        Mend = -1,
             unsigned int        Nend = -1,
-            const bool&         image_method = false,
+            const UVLM::Types::MirrorImages& images = UVLM::Types::MirrorImages(),
+            const UVLM::Types::Real vortex_radius = VORTEX_RADIUS
+        );
+
+        template <typename t_zeta,
+                  typename t_ttriad,
+                  typename t_uout>
+        void whole_surface_influence
+        (
+            const t_zeta&       zeta,
+            const t_ttriad&     target_triad,
+            t_uout&             uout,
+            const uint          offset = 0,
+            const UVLM::Types::MirrorImages& images = UVLM::Types::MirrorImages(),
             const UVLM::Types::Real vortex_radius = VORTEX_RADIUS
         );
 
@@ -240,7 +603,7 @@ namespace UVLM
             const t_zeta_star&  zeta_star,
             const t_gamma&      gamma,
             const t_gamma_star& gamma_star,
-            const bool&         image_method,
+            const UVLM::Types::MirrorImages& images,
             const UVLM::Types::Real vortex_radius = VORTEX_RADIUS
         );
     }
@@ -312,6 +675,152 @@ namespace UVLMlin{
 
 
 // SOURCE CODE
+// Velocity induced by the segment r0 = v2 - v1 at the target x,
+// with r1 = x - v1 and r2 = x - v2
+template <typename t_real>
+inline Eigen::Matrix<t_real, 3, 1> UVLM::BiotSavart::segment_kernel
+(
+    const t_real r0[3],
+    const t_real r1[3],
+    const t_real r2[3],
+    const t_real& gamma
+)
+{
+    return UVLM::BiotSavart::segment_kernel(r0,
+                                            r1,
+                                            r2,
+                                            t_real(std::sqrt(r1[0]*r1[0] + r1[1]*r1[1] + r1[2]*r1[2])),
+                                            t_real(std::sqrt(r2[0]*r2[0] + r2[1]*r2[1] + r2[2]*r2[2])),
+                                            gamma);
+}
+
+
+// As above, with the norms of r1 and r2 already known
+template <typename t_real>
+inline Eigen::Matrix<t_real, 3, 1> UVLM::BiotSavart::segment_kernel
+(
+    const t_real r0[3],
+    const t_real r1[3],
+    const t_real r2[3],
+    const t_real r1_mod,
+    const t_real r2_mod,
+    const t_real& gamma
+)
+{
+    Eigen::Matrix<t_real, 3, 1> uind;
+    const t_real epsilon = t_real(EPSILON_VORTEX);
+
+    t_real r1_cross_r2[3];
+    r1_cross_r2[0] = r1[1]*r2[2] - r1[2]*r2[1];
+    r1_cross_r2[1] = r1[2]*r2[0] - r1[0]*r2[2];
+    r1_cross_r2[2] = r1[0]*r2[1] - r1[1]*r2[0];
+
+    t_real r0_dot_r1;
+    r0_dot_r1 = r0[0]*r1[0] +
+                r0[1]*r1[1] +
+                r0[2]*r1[2];
+
+    t_real r0_dot_r2;
+    r0_dot_r2 = r0[0]*r2[0] +
+                r0[1]*r2[1] +
+                r0[2]*r2[2];
+
+    t_real r1_cross_r2_mod_sq;
+    r1_cross_r2_mod_sq = r1_cross_r2[0]*r1_cross_r2[0] + 
+                         r1_cross_r2[1]*r1_cross_r2[1] + 
+                         r1_cross_r2[2]*r1_cross_r2[2] +
+                         epsilon;
+
+    t_real K;
+    K = (gamma*t_real(UVLM::Constants::INV_PI4)/(r1_cross_r2_mod_sq))*
+        (r0_dot_r1/(r1_mod + epsilon) - r0_dot_r2/(r2_mod + epsilon));
+
+    uind(0) = K*r1_cross_r2[0];
+    uind(1) = K*r1_cross_r2[1];
+    uind(2) = K*r1_cross_r2[2];
+    return uind;
+}
+
+
+template <typename t_real>
+inline bool UVLM::BiotSavart::is_collinear
+(
+    const t_real r0[3],
+    const t_real r1[3]
+)
+{
+    const t_real cross[3] = {r0[1]*r1[2] - r0[2]*r1[1],
+                             r0[2]*r1[0] - r0[0]*r1[2],
+                             r0[0]*r1[1] - r0[1]*r1[0]};
+    const t_real cross_sq = cross[0]*cross[0] + cross[1]*cross[1] + cross[2]*cross[2];
+    const t_real r0_sq = r0[0]*r0[0] + r0[1]*r0[1] + r0[2]*r0[2];
+    const t_real r1_sq = r1[0]*r1[0] + r1[1]*r1[1] + r1[2]*r1[2];
+    return cross_sq < t_real(SINGLE_PRECISION_COLLINEAR*SINGLE_PRECISION_COLLINEAR)*r0_sq*r1_sq;
+}
+
+
+// With c = r1 x r2, D = |c|^2 + eps, S = r0.r1/(|r1| + eps) - r0.r2/(|r2| + eps)
+// and K = gamma/(4 pi) S/D, the velocity is K c, and as dc/dx = [r0]x
+// (the cross product matrix of r0), its gradient is c grad(K)^T + K [r0]x
+// with grad(D) = 2 c x r0.
+inline void UVLM::BiotSavart::segment_gradient_kernel
+(
+    const UVLM::Types::Real r0[3],
+    const UVLM::Types::Real r1[3],
+    const UVLM::Types::Real r2[3],
+    const UVLM::Types::Real& gamma,
+    UVLM::Types::Real uind[3],
+    UVLM::Types::Real grad[9]
+)
+{
+    const UVLM::Types::Real epsilon = EPSILON_VORTEX;
+    const UVLM::Types::Real r1_mod = std::sqrt(r1[0]*r1[0] + r1[1]*r1[1] + r1[2]*r1[2]);
+    const UVLM::Types::Real r2_mod = std::sqrt(r2[0]*r2[0] + r2[1]*r2[1] + r2[2]*r2[2]);
+
+    const UVLM::Types::Real c[3] = {r1[1]*r2[2] - r1[2]*r2[1],
+                                    r1[2]*r2[0] - r1[0]*r2[2],
+                                    r1[0]*r2[1] - r1[1]*r2[0]};
+    const UVLM::Types::Real r0_dot_r1 = r0[0]*r1[0] + r0[1]*r1[1] + r0[2]*r1[2];
+    const UVLM::Types::Real r0_dot_r2 = r0[0]*r2[0] + r0[1]*r2[1] + r0[2]*r2[2];
+    const UVLM::Types::Real inv_D = 1.0/(c[0]*c[0] + c[1]*c[1] + c[2]*c[2] + epsilon);
+    const UVLM::Types::Real inv_a = 1.0/(r1_mod + epsilon);
+    const UVLM::Types::Real inv_b = 1.0/(r2_mod + epsilon);
+    const UVLM::Types::Real factor = gamma*UVLM::Constants::INV_PI4*inv_D;
+    const UVLM::Types::Real K = factor*(r0_dot_r1*inv_a - r0_dot_r2*inv_b);
+
+    // d|r|/dx = r/|r|, taken as zero on the vertices
+    const UVLM::Types::Real r1_inv = (r1_mod > 0.0) ? 1.0/r1_mod : 0.0;
+    const UVLM::Types::Real r2_inv = (r2_mod > 0.0) ? 1.0/r2_mod : 0.0;
+    const UVLM::Types::Real coef_r0 = factor*(inv_a - inv_b);
+    const UVLM::Types::Real coef_r1 = -factor*r0_dot_r1*inv_a*inv_a*r1_inv;
+    const UVLM::Types::Real coef_r2 = factor*r0_dot_r2*inv_b*inv_b*r2_inv;
+    const UVLM::Types::Real coef_D = -2.0*K*inv_D;
+    const UVLM::Types::Real c_cross_r0[3] = {c[1]*r0[2] - c[2]*r0[1],
+                                             c[2]*r0[0] - c[0]*r0[2],
+                                             c[0]*r0[1] - c[1]*r0[0]};
+    UVLM::Types::Real grad_K[3];
+    for (uint j=0; j<3; ++j)
+    {
+        grad_K[j] = coef_r0*r0[j] + coef_r1*r1[j] + coef_r2*r2[j] + coef_D*c_cross_r0[j];
+    }
+
+    for (uint i=0; i<3; ++i)
+    {
+        uind[i] += K*c[i];
+        for (uint j=0; j<3; ++j)
+        {
+            grad[3*i + j] += c[i]*grad_K[j];
+        }
+    }
+    grad[1] -= K*r0[2];
+    grad[2] += K*r0[1];
+    grad[3] += K*r0[2];
+    grad[5] -= K*r0[0];
+    grad[6] -= K*r0[1];
+    grad[7] += K*r0[0];
+}
+
+
 template <typename t_triad>
 inline UVLM::Types::Vector3 UVLM::BiotSavart::segment
         (
@@ -322,58 +831,128 @@ inline UVLM::Types::Vector3 UVLM::BiotSavart::segment
             const UVLM::Types::Real vortex_radius // not used anymore
         )
 {
-    UVLM::Types::Vector3 uind;
-
-    UVLM::Types::Real r0[3], r0_mod;
-    UVLM::Types::Real r1[3], r1_mod;
-    UVLM::Types::Real r2[3], r2_mod;
-    r0_mod = 0.0;
-    r1_mod = 0.0;
-    r2_mod = 0.0;
+    UVLM::Types::Real r0[3];
+    UVLM::Types::Real r1[3];
+    UVLM::Types::Real r2[3];
     // hopefully this loop is unrolled
     for (uint i=0; i<3; ++i)
     {
         r0[i] = v2(i) - v1(i);
         r1[i] = rp(i) - v1(i);
         r2[i] = rp(i) - v2(i);
+    }
+    return UVLM::BiotSavart::segment_kernel(r0, r1, r2, gamma);
+}
+
 
-        r0_mod += r0[i]*r0[i];
-        r1_mod += r1[i]*r1[i];
-        r2_mod += r2[i]*r2[i];
+template <typename t_function>
+inline void UVLM::BiotSavart::with_images
+(
+    const uint n_images,
+    t_function function
+)
+{
+    switch (n_images)
+    {
+        case 0:
+            function(std::integral_constant<uint, 0>());
+            break;
+        case 1:
+            function(std::integral_constant<uint, 1>());
+            break;
+        case 2:
+            function(std::integral_constant<uint, 2>());
+            break;
+        case 3:
+            function(std::integral_constant<uint, 3>());
+            break;
+        default:
+            std::cerr << "ERROR: unsupported number of mirror images "
+                      << n_images << std::endl;
     }
-    r0_mod = sqrt(r0_mod);
-    r1_mod = sqrt(r1_mod);
-    r2_mod = sqrt(r2_mod);
+}
 
 
-    UVLM::Types::Real r1_cross_r2[3];
-    r1_cross_r2[0] = r1[1]*r2[2] - r1[2]*r2[1];
-    r1_cross_r2[1] = r1[2]*r2[0] - r1[0]*r2[2];
-    r1_cross_r2[2] = r1[0]*r2[1] - r1[1]*r2[0];
+template <typename t_function>
+inline void UVLM::BiotSavart::with_flag
+(
+    const bool flag,
+    t_function function
+)
+{
+    if (flag)
+    {
+        function(std::true_type());
+    } else
+    {
+        function(std::false_type());
+    }
+}
 
-    UVLM::Types::Real r0_dot_r1;
-    r0_dot_r1 = r0[0]*r1[0] +
-                r0[1]*r1[1] +
-                r0[2]*r1[2];
 
-    UVLM::Types::Real r0_dot_r2;
-    r0_dot_r2 = r0[0]*r2[0] +
-                r0[1]*r2[1] +
-                r0[2]*r2[2];
+template <typename t_triad>
+inline UVLM::Types::Vector3 UVLM::BiotSavart::segment
+        (
+            const t_triad& rp,
+            const UVLM::Types::Vector3& v1,
+            const UVLM::Types::Vector3& v2,
+            const UVLM::Types::Real& gamma,
+            const UVLM::Types::MirrorImages& images
+        )
+{
+    UVLM::Types::Vector3 uind = UVLM::Types::zeroVector3();
+    UVLM::BiotSavart::with_images(images.n_images, [&](auto n_images)
+    {
+        uind = UVLM::BiotSavart::image_segment<decltype(n_images)::value>(rp,
+                                                                          v1,
+                                                                          v2,
+                                                                          gamma,
+                                                                          images);
+    });
+    return uind;
+}
 
-    UVLM::Types::Real r1_cross_r2_mod_sq;
-    r1_cross_r2_mod_sq = r1_cross_r2[0]*r1_cross_r2[0] + 
-                         r1_cross_r2[1]*r1_cross_r2[1] + 
-                         r1_cross_r2[2]*r1_cross_r2[2] +
-                         EPSILON_VORTEX;
 
-    UVLM::Types::Real K;
-    K = (gamma*UVLM::Constants::INV_PI4/(r1_cross_r2_mod_sq))*
-        (r0_dot_r1/(r1_mod + EPSILON_VORTEX) - r0_dot_r2/(r2_mod + EPSILON_VORTEX));
+// The segment and its images share r0, and the components of r1 and r2
+// along the mirror planes only change sign in the reflected target.
+template <uint n_images,
+          typename t_triad>
+inline UVLM::Types::Vector3 UVLM::BiotSavart::image_segment
+        (
+            const t_triad& rp,
+            const UVLM::Types::Vector3& v1,
+            const UVLM::Types::Vector3& v2,
+            const UVLM::Types::Real& gamma,
+            const UVLM::Types::MirrorImages& images
+        )
+{
+    UVLM::Types::Real r0[3];
+    UVLM::Types::Real r1[3];
+    UVLM::Types::Real r2[3];
+    for (uint i=0; i<3; ++i)
+    {
+        r0[i] = v2(i) - v1(i);
+        r1[i] = rp(i) - v1(i);
+        r2[i] = rp(i) - v2(i);
+    }
+    UVLM::Types::Vector3 uind = UVLM::BiotSavart::segment_kernel(r0, r1, r2, gamma);
 
-    uind(0) = K*r1_cross_r2[0];
-    uind(1) = K*r1_cross_r2[1];
-    uind(2) = K*r1_cross_r2[2];
+    UVLM::Types::Real image_r1[3];
+    UVLM::Types::Real image_r2[3];
+    for (uint i_image=0; i_image<n_images; ++i_image)
+    {
+        const UVLM::Types::Vector3& sign = images.sign[i_image];
+        for (uint i=0; i<3; ++i)
+        {
+            // sign is +-1: the reflected coordinate is exact
+            image_r1[i] = sign(i)*rp(i) - v1(i);
+            image_r2[i] = sign(i)*rp(i) - v2(i);
+        }
+        uind += sign.cwiseProduct(UVLM::BiotSavart::segment_kernel(r0,
+                                                                   image_r1,
+                                                                   image_r2,
+                                                                   gamma));
+    }
     return uind;
 }
 
@@ -388,9 +967,25 @@ void UVLM::BiotSavart::horseshoe
     const t_block& z,
     const UVLM::Types::Real& gamma_star,
     UVLM::Types::Vector3& uind,
+    const UVLM::Types::MirrorImages& images,
     const UVLM::Types::Real vortex_radius
 )
 {
+    // mirror images: the horseshoe evaluated at the reflected target
+    for (uint i_image=0; i_image<images.n_images; ++i_image)
+    {
+        UVLM::Types::Vector3 image_uind = UVLM::Types::zeroVector3();
+        UVLM::BiotSavart::horseshoe(images.reflect(i_image, target_triad),
+                                    x,
+                                    y,
+                                    z,
+                                    gamma_star,
+                                    image_uind,
+                                    UVLM::Types::MirrorImages(),
+                                    vortex_radius);
+        uind += images.reflect(i_image, image_uind);
+    }
+
     // three segments.
     //
     //     0___________3
@@ -512,14 +1107,42 @@ UVLM::Types::Vector3 UVLM::BiotSavart::vortex_ring
     const t_block& z,
     const UVLM::Types::Real& gamma,
     // t_uind& uind,
+    const UVLM::Types::MirrorImages& images,
     const UVLM::Types::Real vortex_radius
 )
 {
-    UVLM::Types::Vector3 uind;
-    uind.setZero();
-    if (std::abs(gamma) < UVLM::Constants::EPSILON)
+    UVLM::Types::Vector3 uind = UVLM::Types::zeroVector3();
+    UVLM::BiotSavart::with_images(images.n_images, [&](auto n_images)
     {
-        return uind;
+        uind = UVLM::BiotSavart::vortex_ring_kernel<decltype(n_images)::value>(target_triad,
+                                                                               x,
+                                                                               y,
+                                                                               z,
+                                                                               gamma,
+                                                                               images);
+    });
+    return uind;
+}
+
+
+template <uint n_images,
+          typename t_triad,
+          typename t_block>
+UVLM::Types::Vector3 UVLM::BiotSavart::vortex_ring_kernel
+(
+    const t_triad& target_triad,
+    const t_block& x,
+    const t_block& y,
+    const t_block& z,
+    const UVLM::Types::Real& gamma,
+    const UVLM::Types::MirrorImages& images
+)
+{
+    UVLM::Types::Vector3 uind;
+    uind.setZero();
+    if (std::abs(gamma) < UVLM::Constants::EPSILON)
+    {
+        return uind;
     }
 
     UVLM::Types::Vector3 v1;
@@ -543,11 +1166,11 @@ UVLM::Types::Vector3 UVLM::BiotSavart::vortex_ring
               z(UVLM::Mapping::vortex_indices(end, 0),
                 UVLM::Mapping::vortex_indices(end, 1));
 
-        uind += UVLM::BiotSavart::segment(target_triad,
-                                          v1,
-                                          v2,
-                                          gamma);
-                                          // uind);
+        uind += UVLM::BiotSavart::image_segment<n_images>(target_triad,
+                                                          v1,
+                                                          v2,
+                                                          gamma,
+                                                          images);
     }
     return uind;
 }
@@ -567,7 +1190,7 @@ void UVLM::BiotSavart::surface
     unsigned int        Nstart,
     unsigned int        Mend,
     unsigned int        Nend,
-    const bool&         image_method,
+    const UVLM::Types::MirrorImages& images,
     const UVLM::Types::Real vortex_radius
 )
 {
@@ -575,6 +1198,39 @@ void UVLM::BiotSavart::surface
     if (Mend == -1) {Mend = gamma.rows();}
     if (Nend == -1) {Nend = gamma.cols();}
 
+    UVLM::BiotSavart::with_images(images.n_images, [&](auto n_images)
+    {
+        UVLM::BiotSavart::surface_kernel<decltype(n_images)::value>(zeta,
+                                                                    gamma,
+                                                                    target_triad,
+                                                                    uout,
+                                                                    Mstart,
+                                                                    Nstart,
+                                                                    Mend,
+                                                                    Nend,
+                                                                    images);
+    });
+}
+
+
+template <uint n_images,
+          typename t_zeta,
+          typename t_gamma,
+          typename t_ttriad,
+          typename t_uout>
+void UVLM::BiotSavart::surface_kernel
+(
+    const t_zeta&       zeta,
+    const t_gamma&      gamma,
+    const t_ttriad&     target_triad,
+    t_uout&             uout,
+    const uint          Mstart,
+    const uint          Nstart,
+    const uint          Mend,
+    const uint          Nend,
+    const UVLM::Types::MirrorImages& images
+)
+{
     UVLM::Types::VecVecMatrixX span_seg_uout;
     UVLM::Types::VecVecMatrixX chord_seg_uout;
     UVLM::Types::allocate_VecVecMat(span_seg_uout, 1, 3, (Mend-Mstart)+1, (Nend-Nstart));
@@ -595,10 +1251,11 @@ void UVLM::BiotSavart::surface
             v2 << zeta[0](i, j+1),
                   zeta[1](i, j+1),
                   zeta[2](i, j+1);
-            temp_uout = UVLM::BiotSavart::segment(target_triad,
-                                                  v1,
-                                                  v2,
-                                                  1.0);
+            temp_uout = UVLM::BiotSavart::image_segment<n_images>(target_triad,
+                                                                  v1,
+                                                                  v2,
+                                                                  1.0,
+                                                                  images);
             span_seg_uout[0][0](i,j) = temp_uout(0);
             span_seg_uout[0][1](i,j) = temp_uout(1);
             span_seg_uout[0][2](i,j) = temp_uout(2);
@@ -607,10 +1264,11 @@ void UVLM::BiotSavart::surface
             v2 << zeta[0](i+1, j),
                   zeta[1](i+1, j),
                   zeta[2](i+1, j);
-            temp_uout = UVLM::BiotSavart::segment(target_triad,
-                                                  v1,
-                                                  v2,
-                                                  1.0);
+            temp_uout = UVLM::BiotSavart::image_segment<n_images>(target_triad,
+                                                                  v1,
+                                                                  v2,
+                                                                  1.0,
+                                                                  images);
             chord_seg_uout[0][0](i,j) = temp_uout(0);
             chord_seg_uout[0][1](i,j) = temp_uout(1);
             chord_seg_uout[0][2](i,j) = temp_uout(2);
@@ -626,10 +1284,11 @@ void UVLM::BiotSavart::surface
         v2 << zeta[0](Mend, j+1),
               zeta[1](Mend, j+1),
               zeta[2](Mend, j+1);
-        temp_uout = UVLM::BiotSavart::segment(target_triad,
-                                              v1,
-                                              v2,
-                                              1.0);
+        temp_uout = UVLM::BiotSavart::image_segment<n_images>(target_triad,
+                                                              v1,
+                                                              v2,
+                                                              1.0,
+                                                              images);
         span_seg_uout[0][0](Mend,j) = temp_uout(0);
         span_seg_uout[0][1](Mend,j) = temp_uout(1);
         span_seg_uout[0][2](Mend,j) = temp_uout(2);
@@ -644,10 +1303,11 @@ void UVLM::BiotSavart::surface
         v2 << zeta[0](i+1, Nend),
               zeta[1](i+1, Nend),
               zeta[2](i+1, Nend);
-        temp_uout = UVLM::BiotSavart::segment(target_triad,
-                                              v1,
-                                              v2,
-                                              1.0);
+        temp_uout = UVLM::BiotSavart::image_segment<n_images>(target_triad,
+                                                              v1,
+                                                              v2,
+                                                              1.0,
+                                                              images);
         chord_seg_uout[0][0](i,Nend) = temp_uout(0);
         chord_seg_uout[0][1](i,Nend) = temp_uout(1);
         chord_seg_uout[0][2](i,Nend) = temp_uout(2);
@@ -688,7 +1348,7 @@ void UVLM::BiotSavart::surface_with_steady_wake
     const t_ttriad&     target_triad,
     const bool&         horseshoe,
     t_uout&             uout,
-    const bool&         image_method,
+    const UVLM::Types::MirrorImages& images,
     const UVLM::Types::Real vortex_radius
 )
 {
@@ -705,10 +1365,75 @@ void UVLM::BiotSavart::surface_with_steady_wake
                               Nstart,
                               Mend,
                               Nend,
-                              image_method);
+                              images);
+
+    // wake contribution, lumped on the trailing edge row
+    UVLM::BiotSavart::steady_wake(zeta_star,
+                                  gamma_star,
+                                  target_triad,
+                                  horseshoe,
+                                  uout,
+                                  Mend - 1,
+                                  images);
+}
+
 
+// Influence of the steady wake (or the horseshoe legs) on a target point.
+// The result of every wake column j is added to uout(i_row, j), where
+// i_row is the trailing edge row of the bound surface in the AIC layout.
+template <typename t_zeta_star,
+          typename t_gamma_star,
+          typename t_ttriad,
+          typename t_uout>
+void UVLM::BiotSavart::steady_wake
+(
+    const t_zeta_star&  zeta_star,
+    const t_gamma_star& gamma_star,
+    const t_ttriad&     target_triad,
+    const bool&         horseshoe,
+    t_uout&             uout,
+    const uint&         i_row,
+    const UVLM::Types::MirrorImages& images,
+    const UVLM::Types::Real vortex_radius
+)
+{
+    UVLM::BiotSavart::with_images(images.n_images, [&](auto n_images)
+    {
+        UVLM::BiotSavart::with_flag(horseshoe, [&](auto is_horseshoe)
+        {
+            UVLM::BiotSavart::steady_wake_kernel<decltype(n_images)::value,
+                                                 decltype(is_horseshoe)::value>(zeta_star,
+                                                                                gamma_star,
+                                                                                target_triad,
+                                                                                uout,
+                                                                                i_row,
+                                                                                images);
+        });
+    });
+}
+
+
+template <uint n_images,
+          bool horseshoe,
+          typename t_zeta_star,
+          typename t_gamma_star,
+          typename t_ttriad,
+          typename t_uout>
+void UVLM::BiotSavart::steady_wake_kernel
+(
+    const t_zeta_star&  zeta_star,
+    const t_gamma_star& gamma_star,
+    const t_ttriad&     target_triad,
+    t_uout&             uout,
+    const uint          i_row,
+    const UVLM::Types::MirrorImages& images
+)
+{
+    const uint Nstart = 0;
+    const uint Nend = gamma_star.cols();
     const uint i0 = 0;
-    const uint i = Mend - 1;
+    const uint i = i_row;
+    // horseshoe is a compile-time constant: only one branch is generated
     if (horseshoe)
     {
         UVLM::Types::Vector3 temp_uout;
@@ -720,7 +1445,8 @@ void UVLM::BiotSavart::surface_with_steady_wake
                                         zeta_star[1].template block<2,2>(i0,j),
                                         zeta_star[2].template block<2,2>(i0,j),
                                         gamma_star(i0,j),
-                                        temp_uout);
+                                        temp_uout,
+                                        images);
             uout[0](i, j) += temp_uout(0);
             uout[1](i, j) += temp_uout(1);
             uout[2](i, j) += temp_uout(2);
@@ -735,12 +1461,12 @@ void UVLM::BiotSavart::surface_with_steady_wake
             // #pragma omp parallel for collapse(1) reduction(sum_Vector3: temp_uout)
             for (uint i_star=0; i_star<mstar; ++i_star)
             {
-                temp_uout += UVLM::BiotSavart::vortex_ring(target_triad,
+                temp_uout += UVLM::BiotSavart::vortex_ring_kernel<n_images>(target_triad,
                                               zeta_star[0].template block<2,2>(i_star, j),
                                               zeta_star[1].template block<2,2>(i_star, j),
                                               zeta_star[2].template block<2,2>(i_star, j),
-                                              gamma_star(i_star, j));
-                                              // temp_uout);
+                                              gamma_star(i_star, j),
+                                              images);
             }
             uout[0](i, j) += temp_uout(0);
             uout[1](i, j) += temp_uout(1);
@@ -764,7 +1490,7 @@ void UVLM::BiotSavart::surface_with_unsteady_wake
     const t_gamma_star& gamma_star,
     const t_ttriad&     target_triad,
     t_uout&             uout,
-    const bool&         image_method,
+    const UVLM::Types::MirrorImages& images,
     const int&          n_rows // default val = -1
 )
 {
@@ -784,34 +1510,64 @@ void UVLM::BiotSavart::surface_with_unsteady_wake
                               Nstart,
                               Mend,
                               Nend,
-                              image_method);
+                              images);
 
     // wake contribution
+    UVLM::BiotSavart::unsteady_wake(zeta_star,
+                                    gamma_star,
+                                    target_triad,
+                                    uout,
+                                    Mend - 1,
+                                    images,
+                                    n_rows);
+}
+
+
+// Influence of the first n_rows rows of the unsteady wake on a target point,
+// added to uout(i_row, j) as in steady_wake.
+template <typename t_zeta_star,
+          typename t_gamma_star,
+          typename t_ttriad,
+          typename t_uout>
+void UVLM::BiotSavart::unsteady_wake
+(
+    const t_zeta_star&  zeta_star,
+    const t_gamma_star& gamma_star,
+    const t_ttriad&     target_triad,
+    t_uout&             uout,
+    const uint&         i_row,
+    const UVLM::Types::MirrorImages& images,
+    const int&          n_rows // default val = -1
+)
+{
+    const uint Nstart = 0;
+    const uint Nend = gamma_star.cols();
     // n_rows controls the number of panels that are included
     // in the final result. Usually for unsteady wake, the value
     // will be 1 when computing AIC coeffs.
     // unless if gamma_star is a dummy one, just a row with ones.
     const uint mstar = (n_rows == -1) ? gamma_star.rows():n_rows;
-    const uint i = Mend - 1;
-    UVLM::Types::Vector3 temp_uout;
-    for (uint j=Nstart; j<Nend; ++j)
+    const uint i = i_row;
+    UVLM::BiotSavart::with_images(images.n_images, [&](auto n_images)
     {
-        temp_uout.setZero();
-        // #pragma omp parallel for collapse(1) reduction(sum_Vector3: temp_uout)
-        for (uint i_star=0; i_star<mstar; ++i_star)
+        UVLM::Types::Vector3 temp_uout;
+        for (uint j=Nstart; j<Nend; ++j)
         {
-            // std::cout << "WARNING: this should not be computed" << std::endl;
-            temp_uout += UVLM::BiotSavart::vortex_ring(target_triad,
-                                          zeta_star[0].template block<2,2>(i_star, j),
-                                          zeta_star[1].template block<2,2>(i_star, j),
-                                          zeta_star[2].template block<2,2>(i_star, j),
-                                          gamma_star(i_star, j));
-                                          // temp_uout);
+            temp_uout.setZero();
+            for (uint i_star=0; i_star<mstar; ++i_star)
+            {
+                temp_uout += UVLM::BiotSavart::vortex_ring_kernel<decltype(n_images)::value>(target_triad,
+                                              zeta_star[0].template block<2,2>(i_star, j),
+                                              zeta_star[1].template block<2,2>(i_star, j),
+                                              zeta_star[2].template block<2,2>(i_star, j),
+                                              gamma_star(i_star, j),
+                                              images);
+            }
+            uout[0](i, j) += temp_uout(0);
+            uout[1](i, j) += temp_uout(1);
+            uout[2](i, j) += temp_uout(2);
         }
-        uout[0](i, j) += temp_uout(0);
-        uout[1](i, j) += temp_uout(1);
-        uout[2](i, j) += temp_uout(2);
-    }
+    });
 }
 
 template <typename t_zeta,
@@ -825,7 +1581,7 @@ void UVLM::BiotSavart::multisurface
     const t_gamma&      gamma,
     const t_tsurface&   target_surface,
     t_uout&             uout,
-    const bool&         image_method,
+    const UVLM::Types::MirrorImages& images,
     const t_normals&    normal,
     const UVLM::Types::Real vortex_radius
 )
@@ -856,7 +1612,12 @@ void UVLM::BiotSavart::multisurface
             UVLM::BiotSavart::surface(zeta,
                                       gamma,
                                       target_triad,
-                                      temp_uout);
+                                      temp_uout,
+                                      0,
+                                      0,
+                                      -1,
+                                      -1,
+                                      images);
 
             // surface_counter = -1;
             // #pragma omp parallel for collapse(2)
@@ -895,7 +1656,7 @@ void UVLM::BiotSavart::multisurface_steady_wake
     const t_tsurface&   target_surface,
     const bool&         horseshoe,
     t_uout&             uout,
-    const bool&         image_method,
+    const UVLM::Types::MirrorImages& images,
     const t_normals&    normal,
     const UVLM::Types::Real vortex_radius
 )
@@ -928,7 +1689,8 @@ void UVLM::BiotSavart::multisurface_steady_wake
                                                        gamma_star,
                                                        target_triad,
                                                        horseshoe,
-                                                       temp_uout
+                                                       temp_uout,
+                                                       images
                                                       );
 
             // #pragma omp parallel for collapse(2)
@@ -962,7 +1724,7 @@ void UVLM::BiotSavart::multisurface_unsteady_wake
     const t_gamma_star& gamma_star,
     const t_tsurface&   target_surface,
     t_uout&             uout,
-    const bool&         image_method,
+    const UVLM::Types::MirrorImages& images,
     const t_normals&    normal,
     const int&          n_rows // default val = -1
 )
@@ -999,7 +1761,7 @@ void UVLM::BiotSavart::multisurface_unsteady_wake
                                                          gamma_star,
                                                          target_triad,
                                                          temp_uout,
-                                                         image_method,
+                                                         images,
                                                          n_rows
                                                         );
 
@@ -1045,38 +1807,12 @@ void UVLM::BiotSavart::whole_surface_on_surface
     const t_gamma& gamma,
     const t_zeta_col& zeta_col,
     t_u_ind& u_ind,
-    const bool image_method
+    const UVLM::Types::MirrorImages& images
 )
 {
-    const uint col_n_M = zeta_col[0].rows();
-    const uint col_n_N = zeta_col[0].cols();
-    const uint n_M = zeta[0].rows();
-    const uint n_N = zeta[0].cols();
-
-    #pragma omp parallel for collapse(2)
-    for (uint col_i_M=0; col_i_M<col_n_M; ++col_i_M)
-    {
-        for (uint col_j_N=0; col_j_N<col_n_N; ++col_j_N)
-        {
-            UVLM::Types::Vector3 target_triad;
-            UVLM::Types::Vector3 uout;
-
-            target_triad << zeta_col[0](col_i_M, col_j_N),
-                            zeta_col[1](col_i_M, col_j_N),
-                            zeta_col[2](col_i_M, col_j_N);
-            uout = UVLM::BiotSavart::whole_surface
-                    (
-                        zeta,
-                        gamma,
-                        target_triad,
-                        // uout,
-                        image_method
-                    );
-            u_ind[0](col_i_M, col_j_N) += uout(0);
-            u_ind[1](col_i_M, col_j_N) += uout(1);
-            u_ind[2](col_i_M, col_j_N) += uout(2);
-        }
-    }
+    UVLM::BiotSavart::SegmentTable segments;
+    segments.add_surface(zeta, gamma);
+    segments.induced_velocities_on_surface(zeta_col, u_ind, images);
 }
 
 
@@ -1094,7 +1830,7 @@ UVLM::Types::Vector3 UVLM::BiotSavart::whole_surface
     unsigned int        Nstart,
     unsigned int        Mend,
     unsigned int        Nend,
-    const bool&         image_method,
+    const UVLM::Types::MirrorImages& images,
     const UVLM::Types::Real vortex_radius
 )
 {
@@ -1102,85 +1838,842 @@ UVLM::Types::Vector3 UVLM::BiotSavart::whole_surface
     if (Mend == -1) {Mend = gamma.rows();}
     if (Nend == -1) {Nend = gamma.cols();}
 
-    UVLM::Types::Vector3 uout;
-    uout.setZero();
-    UVLM::Types::Vector3 temp_uout;
-    UVLM::Types::Vector3 v1;
-    UVLM::Types::Vector3 v2;
-    UVLM::Types::Real delta_gamma;
-    for (unsigned int i=Mstart; i<Mend; ++i)
+    UVLM::Types::Vector3 uout = UVLM::Types::zeroVector3();
+    UVLM::BiotSavart::with_images(images.n_images, [&](auto n_images)
     {
+        uout = UVLM::BiotSavart::whole_surface_kernel<decltype(n_images)::value>(zeta,
+                                                                                 gamma,
+                                                                                 target_triad,
+                                                                                 Mstart,
+                                                                                 Nstart,
+                                                                                 Mend,
+                                                                                 Nend,
+                                                                                 images);
+    });
+    return uout;
+}
 
+
+template <uint n_images,
+          typename t_zeta,
+          typename t_gamma,
+          typename t_ttriad>
+UVLM::Types::Vector3 UVLM::BiotSavart::whole_surface_kernel
+(
+    const t_zeta&       zeta,
+    const t_gamma&      gamma,
+    const t_ttriad&     target_triad,
+    const uint          Mstart,
+    const uint          Nstart,
+    const uint          Mend,
+    const uint          Nend,
+    const UVLM::Types::MirrorImages& images
+)
+{
+    // The target and its mirror images
+    const uint n_targets = 1 + n_images;
+    UVLM::Types::Vector3 targets[n_targets];
+    UVLM::Types::Vector3 target_uout[n_targets];
+    targets[0] = target_triad;
+    for (uint i_image=0; i_image<n_images; ++i_image)
+    {
+        targets[1 + i_image] = images.reflect(i_image, target_triad);
+    }
+    for (uint i_target=0; i_target<n_targets; ++i_target)
+    {
+        target_uout[i_target].setZero();
+    }
+
+    // Vectors from the vertices of two consecutive rows to the targets
+    // and their norms, (x, y, z, norm) per target and vertex, so every
+    // vertex distance is computed once instead of once per segment.
+    const uint n_vertices = Nend - Nstart + 1;
+    const uint row_size = 4*n_targets*n_vertices;
+    std::vector<UVLM::Types::Real> buffer(2*row_size);
+    UVLM::Types::Real* previous = buffer.data();
+    UVLM::Types::Real* current = buffer.data() + row_size;
+    // circulation of the spanwise and chordwise segments of a row, set
+    // before the segment loops so that these have no tests for the edges
+    std::vector<UVLM::Types::Real> span_gamma(Nend - Nstart);
+    std::vector<UVLM::Types::Real> chord_gamma(n_vertices);
+
+    UVLM::Types::Real r0[3];
+    for (unsigned int i=Mstart; i<=Mend; ++i)
+    {
+        for (uint i_vertex=0; i_vertex<n_vertices; ++i_vertex)
+        {
+            for (uint i_target=0; i_target<n_targets; ++i_target)
+            {
+                UVLM::Types::Real* r = current + 4*(i_vertex*n_targets + i_target);
+                r[0] = targets[i_target](0) - zeta[0](i, Nstart + i_vertex);
+                r[1] = targets[i_target](1) - zeta[1](i, Nstart + i_vertex);
+                r[2] = targets[i_target](2) - zeta[2](i, Nstart + i_vertex);
+                r[3] = sqrt(r[0]*r[0] + r[1]*r[1] + r[2]*r[2]);
+            }
+        }
+
+        // Spanwise vortices of the row: gamma(i - 1, j) - gamma(i, j)
+        std::fill(span_gamma.begin(), span_gamma.end(), 0.0);
+        if (i < Mend)
+        {
+            for (unsigned int j=Nstart; j<Nend; ++j) {span_gamma[j - Nstart] -= gamma(i, j);}
+        }
+        if (i > Mstart)
+        {
+            for (unsigned int j=Nstart; j<Nend; ++j) {span_gamma[j - Nstart] += gamma(i - 1, j);}
+        }
         for (unsigned int j=Nstart; j<Nend; ++j)
         {
+            const UVLM::Types::Real segment_gamma = span_gamma[j - Nstart];
+            const UVLM::Types::Real* r1 = current + 4*(j - Nstart)*n_targets;
+            const UVLM::Types::Real* r2 = r1 + 4*n_targets;
+            for (uint i_target=0; i_target<n_targets; ++i_target)
+            {
+                const UVLM::Types::Real* t_r1 = r1 + 4*i_target;
+                const UVLM::Types::Real* t_r2 = r2 + 4*i_target;
+                r0[0] = t_r1[0] - t_r2[0];
+                r0[1] = t_r1[1] - t_r2[1];
+                r0[2] = t_r1[2] - t_r2[2];
+                target_uout[i_target] += UVLM::BiotSavart::segment_kernel(r0,
+                                                                          t_r1,
+                                                                          t_r2,
+                                                                          t_r1[3],
+                                                                          t_r2[3],
+                                                                          segment_gamma);
+            }
+        }
 
-            // Spanwise vortices
+        // Streamwise/chordwise vortices between the rows i - 1 and i:
+        // gamma(i - 1, j) - gamma(i - 1, j - 1)
+        if (i > Mstart)
+        {
+            std::fill(chord_gamma.begin(), chord_gamma.end(), 0.0);
+            for (unsigned int j=Nstart; j<Nend; ++j) {chord_gamma[j - Nstart] += gamma(i - 1, j);}
+            for (unsigned int j=Nstart + 1; j<=Nend; ++j) {chord_gamma[j - Nstart] -= gamma(i - 1, j - 1);}
+            for (unsigned int j=Nstart; j<=Nend; ++j)
+            {
+                const UVLM::Types::Real segment_gamma = chord_gamma[j - Nstart];
+                const UVLM::Types::Real* r1 = previous + 4*(j - Nstart)*n_targets;
+                const UVLM::Types::Real* r2 = current + 4*(j - Nstart)*n_targets;
+                for (uint i_target=0; i_target<n_targets; ++i_target)
+                {
+                    const UVLM::Types::Real* t_r1 = r1 + 4*i_target;
+                    const UVLM::Types::Real* t_r2 = r2 + 4*i_target;
+                    r0[0] = t_r1[0] - t_r2[0];
+                    r0[1] = t_r1[1] - t_r2[1];
+                    r0[2] = t_r1[2] - t_r2[2];
+                    target_uout[i_target] += UVLM::BiotSavart::segment_kernel(r0,
+                                                                              t_r1,
+                                                                              t_r2,
+                                                                              t_r1[3],
+                                                                              t_r2[3],
+                                                                              segment_gamma);
+                }
+            }
+        }
+        std::swap(previous, current);
+    }
+
+    UVLM::Types::Vector3 uout = target_uout[0];
+    for (uint i_image=0; i_image<n_images; ++i_image)
+    {
+        uout += images.sign[i_image].cwiseProduct(target_uout[1 + i_image]);
+    }
+    return uout;
+}
+
+// Linear map of whole_surface: the velocity induced at target_triad by
+// the panel (i, j) with unit circulation is added to the column
+// offset + i*N + j of uout (3 rows).
+template <typename t_zeta,
+          typename t_ttriad,
+          typename t_uout>
+void UVLM::BiotSavart::whole_surface_influence
+(
+    const t_zeta&       zeta,
+    const t_ttriad&     target_triad,
+    t_uout&             uout,
+    const uint          offset,
+    const UVLM::Types::MirrorImages& images,
+    const UVLM::Types::Real vortex_radius
+)
+{
+    const uint M = zeta[0].rows() - 1;
+    const uint N = zeta[0].cols() - 1;
+
+    UVLM::Types::Vector3 v1;
+    UVLM::Types::Vector3 v2;
+    UVLM::Types::Vector3 u_segment;
+    for (uint i=0; i<=M; ++i)
+    {
+        for (uint j=0; j<N; ++j)
+        {
+            // Spanwise vortices: -gamma(i, j) + gamma(i-1, j)
             v1 << zeta[0](i, j),
                   zeta[1](i, j),
                   zeta[2](i, j);
             v2 << zeta[0](i, j+1),
                   zeta[1](i, j+1),
                   zeta[2](i, j+1);
-
-            if (i == Mstart){
-                delta_gamma = gamma(i, j);
-            } else {
-                delta_gamma = gamma(i, j) - gamma(i-1, j);
-            }
-            uout += UVLM::BiotSavart::segment(target_triad,
+            u_segment = UVLM::BiotSavart::segment(target_triad,
                                                   v1,
                                                   v2,
-                                                  -delta_gamma);
-
-            // Streamwise/chordwise vortices
+                                                  1.0,
+                                                  images);
+            if (i < M) {uout.col(offset + i*N + j) -= u_segment;}
+            if (i > 0) {uout.col(offset + (i-1)*N + j) += u_segment;}
+        }
+    }
+    for (uint i=0; i<M; ++i)
+    {
+        for (uint j=0; j<=N; ++j)
+        {
+            // Streamwise/chordwise vortices: gamma(i, j) - gamma(i, j-1)
+            v1 << zeta[0](i, j),
+                  zeta[1](i, j),
+                  zeta[2](i, j);
             v2 << zeta[0](i+1, j),
                   zeta[1](i+1, j),
                   zeta[2](i+1, j);
-
-            if (j == Nstart){
-                delta_gamma = -gamma(i, j);
-            } else {
-                delta_gamma = gamma(i, j-1) - gamma(i, j);
-            }
-            uout += UVLM::BiotSavart::segment(target_triad,
+            u_segment = UVLM::BiotSavart::segment(target_triad,
                                                   v1,
                                                   v2,
-                                                  -delta_gamma);
+                                                  1.0,
+                                                  images);
+            if (j < N) {uout.col(offset + i*N + j) += u_segment;}
+            if (j > 0) {uout.col(offset + i*N + j - 1) -= u_segment;}
         }
     }
-    for (unsigned int j=Nstart; j<Nend; ++j)
+}
+
+
+inline const UVLM::BiotSavart::CacheTiles& UVLM::BiotSavart::cache_tiles()
+{
+    static const UVLM::BiotSavart::CacheTiles tiles = []()
     {
-        // Spanwise vortices
-        v1 << zeta[0](Mend, j),
-              zeta[1](Mend, j),
-              zeta[2](Mend, j);
-        v2 << zeta[0](Mend, j+1),
-              zeta[1](Mend, j+1),
-              zeta[2](Mend, j+1);
-        uout += UVLM::BiotSavart::segment(target_triad,
-                                              v1,
-                                              v2,
-                                              gamma(Mend-1,j));
+        long l1_size = 0;
+        long l2_size = 0;
+#ifdef _SC_LEVEL1_DCACHE_SIZE
+        l1_size = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+        l2_size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+        if (l1_size <= 0) {l1_size = 32*1024;}
+        if (l2_size <= 0) {l2_size = 256*1024;}
+
+        UVLM::BiotSavart::CacheTiles tiles;
+        // half of L1 for the 7 values of a segment
+        tiles.segments = std::max(64L, l1_size/(2*7*long(sizeof(UVLM::Types::Real))));
+        // half of L2 for the 6 values of a target (and up to 3 images),
+        // bounded so that the threads still get several tiles each
+        tiles.targets = std::min(256L, std::max(16L, l2_size/(2*4*6*long(sizeof(UVLM::Types::Real)))));
+        return tiles;
+    }();
+    return tiles;
+}
+
+
+void UVLM::BiotSavart::SegmentTable::clear()
+{
+    x.clear(); y.clear(); z.clear();
+    dx.clear(); dy.clear(); dz.clear();
+    circulation.clear();
+    single_columns.clear();
+    morton_order = false;
+}
+
+
+void UVLM::BiotSavart::SegmentTable::use_single_precision()
+{
+    const uint n_segments = size();
+    single_columns.resize(7*n_segments);
+    for (uint i_segment=0; i_segment<n_segments; ++i_segment)
+    {
+        single_columns[i_segment] = float(x[i_segment]);
+        single_columns[n_segments + i_segment] = float(y[i_segment]);
+        single_columns[2*n_segments + i_segment] = float(z[i_segment]);
+        single_columns[3*n_segments + i_segment] = float(x[i_segment] + dx[i_segment]);
+        single_columns[4*n_segments + i_segment] = float(y[i_segment] + dy[i_segment]);
+        single_columns[5*n_segments + i_segment] = float(z[i_segment] + dz[i_segment]);
+        single_columns[6*n_segments + i_segment] = float(circulation[i_segment]);
     }
+}
+
 
-    for (unsigned int i=Mstart; i<Mend; ++i)
+void UVLM::BiotSavart::SegmentTable::sort_morton()
+{
+    const uint n_segments = size();
+    UVLM::Types::MatrixX midpoints(n_segments, UVLM::Constants::NDIM);
+    for (uint i_segment=0; i_segment<n_segments; ++i_segment)
     {
-        // Streamwise/chordwise vortices
-        v1 << zeta[0](i, Nend),
-              zeta[1](i, Nend),
-              zeta[2](i, Nend);
-        v2 << zeta[0](i+1, Nend),
-              zeta[1](i+1, Nend),
-              zeta[2](i+1, Nend);
+        midpoints(i_segment, 0) = x[i_segment] + 0.5*dx[i_segment];
+        midpoints(i_segment, 1) = y[i_segment] + 0.5*dy[i_segment];
+        midpoints(i_segment, 2) = z[i_segment] + 0.5*dz[i_segment];
+    }
+    const std::vector<uint> order = UVLM::Morton::order(midpoints);
 
-        uout += UVLM::BiotSavart::segment(target_triad,
-                                              v1,
-                                              v2,
-                                              -gamma(i, Nend-1));
+    std::vector<UVLM::Types::Real>* columns[7] = {&x, &y, &z, &dx, &dy, &dz, &circulation};
+    std::vector<UVLM::Types::Real> sorted(n_segments);
+    for (uint i_column=0; i_column<7; ++i_column)
+    {
+        for (uint i_segment=0; i_segment<n_segments; ++i_segment)
+        {
+            sorted[i_segment] = (*columns[i_column])[order[i_segment]];
+        }
+        columns[i_column]->swap(sorted);
+    }
+    morton_order = true;
+    if (!single_columns.empty()) {use_single_precision();}
+}
+
+
+template <typename t_zeta>
+void UVLM::BiotSavart::SegmentTable::add_segment
+(
+    const t_zeta& zeta,
+    const uint i_start,
+    const uint j_start,
+    const uint i_end,
+    const uint j_end,
+    const UVLM::Types::Real segment_circulation
+)
+{
+    if (segment_circulation == 0.0) {return;}
+    x.push_back(zeta[0](i_start, j_start));
+    y.push_back(zeta[1](i_start, j_start));
+    z.push_back(zeta[2](i_start, j_start));
+    dx.push_back(zeta[0](i_end, j_end) - zeta[0](i_start, j_start));
+    dy.push_back(zeta[1](i_end, j_end) - zeta[1](i_start, j_start));
+    dz.push_back(zeta[2](i_end, j_end) - zeta[2](i_start, j_start));
+    circulation.push_back(segment_circulation);
+}
+
+
+// Edges of a lattice with the same orientation and circulation as in
+// whole_surface. The spanwise edges of the first and last vertex rows are
+// only added if leading_edge and trailing_edge are true.
+template <typename t_zeta,
+          typename t_gamma>
+void UVLM::BiotSavart::SegmentTable::add_lattice
+(
+    const t_zeta& zeta,
+    const t_gamma& gamma,
+    const bool leading_edge,
+    const bool trailing_edge
+)
+{
+    const uint M = gamma.rows();
+    const uint N = gamma.cols();
+    // Spanwise vortices: gamma(i - 1, j) - gamma(i, j)
+    for (uint i=0; i<=M; ++i)
+    {
+        if ((i == 0 && !leading_edge) || (i == M && !trailing_edge)) {continue;}
+        for (uint j=0; j<N; ++j)
+        {
+            UVLM::Types::Real segment_circulation = 0.0;
+            if (i < M) {segment_circulation -= gamma(i, j);}
+            if (i > 0) {segment_circulation += gamma(i - 1, j);}
+            add_segment(zeta, i, j, i, j + 1, segment_circulation);
+        }
+    }
+    // Streamwise/chordwise vortices: gamma(i, j) - gamma(i, j - 1)
+    for (uint i=0; i<M; ++i)
+    {
+        for (uint j=0; j<=N; ++j)
+        {
+            UVLM::Types::Real segment_circulation = 0.0;
+            if (j < N) {segment_circulation += gamma(i, j);}
+            if (j > 0) {segment_circulation -= gamma(i, j - 1);}
+            add_segment(zeta, i, j, i + 1, j, segment_circulation);
+        }
+    }
+}
+
+
+template <typename t_zeta,
+          typename t_gamma>
+void UVLM::BiotSavart::SegmentTable::add_surface
+(
+    const t_zeta& zeta,
+    const t_gamma& gamma
+)
+{
+    add_lattice(zeta, gamma, true, true);
+}
+
+
+template <typename t_zeta,
+          typename t_zeta_star,
+          typename t_gamma,
+          typename t_gamma_star>
+void UVLM::BiotSavart::SegmentTable::add_surface
+(
+    const t_zeta& zeta,
+    const t_zeta_star& zeta_star,
+    const t_gamma& gamma,
+    const t_gamma_star& gamma_star
+)
+{
+    const uint M = gamma.rows();
+    const uint N = gamma.cols();
+    bool shared_edge = (gamma_star.rows() > 0) && (gamma_star.cols() == N);
+    for (uint j=0; shared_edge && j<=N; ++j)
+    {
+        for (uint i_dim=0; i_dim<UVLM::Constants::NDIM; ++i_dim)
+        {
+            shared_edge = shared_edge && (zeta[i_dim](M, j) == zeta_star[i_dim](0, j));
+        }
+    }
+
+    add_lattice(zeta, gamma, true, !shared_edge);
+    add_lattice(zeta_star, gamma_star, !shared_edge, true);
+    if (shared_edge)
+    {
+        for (uint j=0; j<N; ++j)
+        {
+            add_segment(zeta, M, j, M, j + 1, gamma(M - 1, j) - gamma_star(0, j));
+        }
+    }
+}
+
+
+UVLM::Types::Vector3 UVLM::BiotSavart::SegmentTable::velocity
+(
+    const UVLM::Types::Vector3& target
+) const
+{
+    UVLM::Types::Real uout[3] = {0.0, 0.0, 0.0};
+    const uint n_segments = size();
+    UVLM::ISA::dispatch([&]()
+    {
+        UVLM::Types::Real u[3] = {0.0, 0.0, 0.0};
+        UVLM::Types::Real r0[3];
+        UVLM::Types::Real r1[3];
+        UVLM::Types::Real r2[3];
+        for (uint i_segment=0; i_segment<n_segments; ++i_segment)
+        {
+            r0[0] = dx[i_segment];
+            r0[1] = dy[i_segment];
+            r0[2] = dz[i_segment];
+            r1[0] = target(0) - x[i_segment];
+            r1[1] = target(1) - y[i_segment];
+            r1[2] = target(2) - z[i_segment];
+            r2[0] = r1[0] - r0[0];
+            r2[1] = r1[1] - r0[1];
+            r2[2] = r1[2] - r0[2];
+            const UVLM::Types::Vector3 uind = UVLM::BiotSavart::segment_kernel(r0,
+                                                                               r1,
+                                                                               r2,
+                                                                               circulation[i_segment]);
+            u[0] += uind(0);
+            u[1] += uind(1);
+            u[2] += uind(2);
+        }
+        uout[0] = u[0];
+        uout[1] = u[1];
+        uout[2] = u[2];
+    });
+    return UVLM::Types::Vector3(uout[0], uout[1], uout[2]);
+}
+
+
+template <typename t_targets,
+          typename t_uout>
+void UVLM::BiotSavart::SegmentTable::induced_velocities
+(
+    const t_targets& targets,
+    t_uout& uout,
+    const UVLM::Types::MirrorImages& images
+) const
+{
+    if (single_columns.empty())
+    {
+        const UVLM::Types::Real* const columns[7] =
+            {x.data(), y.data(), z.data(), dx.data(), dy.data(), dz.data(), circulation.data()};
+        evaluate_tiles(columns, targets, uout, images);
+    } else
+    {
+        const uint n_segments = size();
+        const float* const columns[7] =
+            {single_columns.data(),
+             single_columns.data() + n_segments,
+             single_columns.data() + 2*n_segments,
+             single_columns.data() + 3*n_segments,
+             single_columns.data() + 4*n_segments,
+             single_columns.data() + 5*n_segments,
+             single_columns.data() + 6*n_segments};
+        evaluate_tiles(columns, targets, uout, images);
+    }
+}
+
+
+template <typename t_targets>
+std::vector<uint> UVLM::BiotSavart::SegmentTable::target_order
+(
+    const t_targets& targets
+) const
+{
+    if (morton_order)
+    {
+        return UVLM::Morton::order(targets);
+    }
+    std::vector<uint> order(targets.rows());
+    std::iota(order.begin(), order.end(), 0);
+    return order;
+}
+
+
+// Same tiles as evaluate_tiles, in double precision. The gradient of the
+// velocity induced by an image is S grad(S x) S, S being the signs of
+// its mirror planes.
+template <typename t_targets,
+          typename t_uout,
+          typename t_gradients>
+void UVLM::BiotSavart::SegmentTable::induced_velocities_and_gradients
+(
+    const t_targets& targets,
+    t_uout& uout,
+    t_gradients& gradients,
+    const UVLM::Types::MirrorImages& images
+) const
+{
+    const uint n_targets = targets.rows();
+    const uint n_segments = size();
+    const uint n_copies = 1 + images.n_images;
+    const UVLM::BiotSavart::CacheTiles& tiles = UVLM::BiotSavart::cache_tiles();
+    const uint n_tiles = (n_targets + tiles.targets - 1)/tiles.targets;
+    const std::vector<uint> order = target_order(targets);
+
+    #pragma omp parallel for schedule(dynamic)
+    for (uint i_tile=0; i_tile<n_tiles; ++i_tile)
+    {
+        const uint first = i_tile*tiles.targets;
+        const uint n_tile = std::min(n_targets, first + tiles.targets) - first;
+        std::vector<UVLM::Types::Real> tile_targets(3*n_copies*n_tile);
+        std::vector<UVLM::Types::Real> tile_uout(3*n_copies*n_tile, 0.0);
+        std::vector<UVLM::Types::Real> tile_gradients(9*n_copies*n_tile, 0.0);
+        for (uint i_target=0; i_target<n_tile; ++i_target)
+        {
+            const uint i_row = order[first + i_target];
+            UVLM::Types::Vector3 target;
+            target << targets(i_row, 0),
+                      targets(i_row, 1),
+                      targets(i_row, 2);
+            for (uint i_copy=0; i_copy<n_copies; ++i_copy)
+            {
+                Eigen::Map<UVLM::Types::Vector3>(tile_targets.data() + 3*(i_copy*n_tile + i_target)) =
+                    (i_copy == 0) ? target : images.reflect(i_copy - 1, target);
+            }
+        }
+
+        UVLM::ISA::dispatch([&]()
+        {
+            for (uint first_segment=0; first_segment<n_segments; first_segment+=tiles.segments)
+            {
+                const uint last_segment = std::min(n_segments, first_segment + tiles.segments);
+                for (uint i_target=0; i_target<n_copies*n_tile; ++i_target)
+                {
+                    const UVLM::Types::Real* t = tile_targets.data() + 3*i_target;
+                    UVLM::Types::Real u[3] = {0.0, 0.0, 0.0};
+                    UVLM::Types::Real grad[9] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+                    for (uint i_segment=first_segment; i_segment<last_segment; ++i_segment)
+                    {
+                        const UVLM::Types::Real r0[3] = {dx[i_segment], dy[i_segment], dz[i_segment]};
+                        const UVLM::Types::Real r1[3] = {t[0] - x[i_segment],
+                                                         t[1] - y[i_segment],
+                                                         t[2] - z[i_segment]};
+                        const UVLM::Types::Real r2[3] = {r1[0] - r0[0],
+                                                         r1[1] - r0[1],
+                                                         r1[2] - r0[2]};
+                        UVLM::BiotSavart::segment_gradient_kernel(r0,
+                                                                  r1,
+                                                                  r2,
+                                                                  circulation[i_segment],
+                                                                  u,
+                                                                  grad);
+                    }
+                    for (uint i=0; i<3; ++i)
+                    {
+                        tile_uout[3*i_target + i] += u[i];
+                    }
+                    for (uint i=0; i<9; ++i)
+                    {
+                        tile_gradients[9*i_target + i] += grad[i];
+                    }
+                }
+            }
+        });
+
+        for (uint i_target=0; i_target<n_tile; ++i_target)
+        {
+            UVLM::Types::Vector3 u_target = Eigen::Map<const UVLM::Types::Vector3>(tile_uout.data() + 3*i_target);
+            UVLM::Types::Real grad_target[9];
+            std::copy(tile_gradients.data() + 9*i_target,
+                      tile_gradients.data() + 9*(i_target + 1),
+                      grad_target);
+            for (uint i_image=0; i_image<images.n_images; ++i_image)
+            {
+                const UVLM::Types::Vector3& sign = images.sign[i_image];
+                const uint i_copy = (1 + i_image)*n_tile + i_target;
+                u_target += sign.cwiseProduct(
+                    Eigen::Map<const UVLM::Types::Vector3>(tile_uout.data() + 3*i_copy));
+                for (uint i=0; i<3; ++i)
+                {
+                    for (uint j=0; j<3; ++j)
+                    {
+                        grad_target[3*i + j] += sign(i)*sign(j)*tile_gradients[9*i_copy + 3*i + j];
+                    }
+                }
+            }
+            const uint i_row = order[first + i_target];
+            for (uint i=0; i<3; ++i)
+            {
+                uout(i_row, i) += u_target(i);
+            }
+            for (uint i=0; i<9; ++i)
+            {
+                gradients(i_row, i) += grad_target[i];
+            }
+        }
+    }
+}
+
+
+// Tiled evaluation with the segments and targets in the working precision
+// t_real, while the velocities of the targets are accumulated in Real.
+template <typename t_real,
+          typename t_targets,
+          typename t_uout>
+void UVLM::BiotSavart::SegmentTable::evaluate_tiles
+(
+    const t_real* const columns[7],
+    const t_targets& targets,
+    t_uout& uout,
+    const UVLM::Types::MirrorImages& images
+) const
+{
+    const t_real* const seg_x = columns[0];
+    const t_real* const seg_y = columns[1];
+    const t_real* const seg_z = columns[2];
+    const t_real* const seg_dx = columns[3];
+    const t_real* const seg_dy = columns[4];
+    const t_real* const seg_dz = columns[5];
+    const t_real* const seg_circulation = columns[6];
+    // the single precision columns 3 to 5 are the end points instead of
+    // the directions, so that a target on a vertex is exactly at the end
+    // of the segments that share it
+    const bool single_precision = !std::is_same<t_real, UVLM::Types::Real>::value;
+
+    const uint n_targets = targets.rows();
+    const uint n_segments = size();
+    const uint n_copies = 1 + images.n_images;
+    const UVLM::BiotSavart::CacheTiles& tiles = UVLM::BiotSavart::cache_tiles();
+    const uint n_tiles = (n_targets + tiles.targets - 1)/tiles.targets;
+    // row of targets of every evaluated target
+    const std::vector<uint> order = target_order(targets);
+
+    #pragma omp parallel for schedule(dynamic)
+    for (uint i_tile=0; i_tile<n_tiles; ++i_tile)
+    {
+        const uint first = i_tile*tiles.targets;
+        const uint n_tile = std::min(n_targets, first + tiles.targets) - first;
+        // targets of the tile and their images, and their velocities
+        std::vector<t_real> tile_targets(3*n_copies*n_tile);
+        std::vector<UVLM::Types::Real> tile_targets_double(3*n_copies*n_tile);
+        std::vector<UVLM::Types::Real> tile_uout(3*n_copies*n_tile, 0.0);
+        for (uint i_target=0; i_target<n_tile; ++i_target)
+        {
+            const uint i_row = order[first + i_target];
+            UVLM::Types::Vector3 target;
+            target << targets(i_row, 0),
+                      targets(i_row, 1),
+                      targets(i_row, 2);
+            for (uint i_copy=0; i_copy<n_copies; ++i_copy)
+            {
+                t_real* t = tile_targets.data() + 3*(i_copy*n_tile + i_target);
+                const UVLM::Types::Vector3 copy =
+                    (i_copy == 0) ? target : images.reflect(i_copy - 1, target);
+                t[0] = t_real(copy(0));
+                t[1] = t_real(copy(1));
+                t[2] = t_real(copy(2));
+                Eigen::Map<UVLM::Types::Vector3>(tile_targets_double.data() + 3*(i_copy*n_tile + i_target)) = copy;
+            }
+        }
+
+        // the segment tiles with the instruction set of the CPU
+        UVLM::ISA::dispatch([&]()
+        {
+            for (uint first_segment=0; first_segment<n_segments; first_segment+=tiles.segments)
+            {
+                const uint last_segment = std::min(n_segments, first_segment + tiles.segments);
+                for (uint i_target=0; i_target<n_copies*n_tile; ++i_target)
+                {
+                    const t_real* t = tile_targets.data() + 3*i_target;
+                    auto relative_position = [&](const uint i_segment, t_real r0[3], t_real r1[3], t_real r2[3])
+                    {
+                        r1[0] = t[0] - seg_x[i_segment];
+                        r1[1] = t[1] - seg_y[i_segment];
+                        r1[2] = t[2] - seg_z[i_segment];
+                        if (single_precision)
+                        {
+                            r2[0] = t[0] - seg_dx[i_segment];
+                            r2[1] = t[1] - seg_dy[i_segment];
+                            r2[2] = t[2] - seg_dz[i_segment];
+                            r0[0] = r1[0] - r2[0];
+                            r0[1] = r1[1] - r2[1];
+                            r0[2] = r1[2] - r2[2];
+                        } else
+                        {
+                            r0[0] = seg_dx[i_segment];
+                            r0[1] = seg_dy[i_segment];
+                            r0[2] = seg_dz[i_segment];
+                            r2[0] = r1[0] - r0[0];
+                            r2[1] = r1[1] - r0[1];
+                            r2[2] = r1[2] - r0[2];
+                        }
+                    };
+
+                    // partial sums of the segment tile in the working precision
+                    t_real u[3] = {0.0, 0.0, 0.0};
+                    uint n_collinear = 0;
+                    for (uint i_segment=first_segment; i_segment<last_segment; ++i_segment)
+                    {
+                        t_real r0[3];
+                        t_real r1[3];
+                        t_real r2[3];
+                        relative_position(i_segment, r0, r1, r2);
+                        const Eigen::Matrix<t_real, 3, 1> uind =
+                            UVLM::BiotSavart::segment_kernel(r0,
+                                                             r1,
+                                                             r2,
+                                                             seg_circulation[i_segment]);
+                        if (single_precision)
+                        {
+                            // masked instead of branching, redone below
+                            const bool collinear = UVLM::BiotSavart::is_collinear(r0, r1);
+                            const t_real mask = collinear ? t_real(0.0) : t_real(1.0);
+                            n_collinear += collinear;
+                            u[0] += mask*uind(0);
+                            u[1] += mask*uind(1);
+                            u[2] += mask*uind(2);
+                        } else
+                        {
+                            u[0] += uind(0);
+                            u[1] += uind(1);
+                            u[2] += uind(2);
+                        }
+                    }
+                    UVLM::Types::Real* target_uout = tile_uout.data() + 3*i_target;
+                    target_uout[0] += u[0];
+                    target_uout[1] += u[1];
+                    target_uout[2] += u[2];
+
+                    // The regularisation of the kernel is tuned for double
+                    // precision: close to the line of a segment the single
+                    // precision result is round-off, so it is evaluated again
+                    // in double.
+                    for (uint i_segment=first_segment; n_collinear>0 && i_segment<last_segment; ++i_segment)
+                    {
+                        t_real r0[3];
+                        t_real r1[3];
+                        t_real r2[3];
+                        relative_position(i_segment, r0, r1, r2);
+                        if (!UVLM::BiotSavart::is_collinear(r0, r1)) {continue;}
+                        --n_collinear;
+
+                        const UVLM::Types::Real* t_double = tile_targets_double.data() + 3*i_target;
+                        UVLM::Types::Real r0_double[3] = {dx[i_segment], dy[i_segment], dz[i_segment]};
+                        UVLM::Types::Real r1_double[3];
+                        UVLM::Types::Real r2_double[3];
+                        for (uint i_dim=0; i_dim<UVLM::Constants::NDIM; ++i_dim)
+                        {
+                            r1_double[i_dim] = t_double[i_dim] - (i_dim == 0 ? x : (i_dim == 1 ? y : z))[i_segment];
+                            r2_double[i_dim] = r1_double[i_dim] - r0_double[i_dim];
+                        }
+                        const UVLM::Types::Vector3 uind = UVLM::BiotSavart::segment_kernel(r0_double,
+                                                                                           r1_double,
+                                                                                           r2_double,
+                                                                                           circulation[i_segment]);
+                        target_uout[0] += uind(0);
+                        target_uout[1] += uind(1);
+                        target_uout[2] += uind(2);
+                    }
+                }
+            }
+        });
+
+        for (uint i_target=0; i_target<n_tile; ++i_target)
+        {
+            UVLM::Types::Vector3 u_target = Eigen::Map<const UVLM::Types::Vector3>(tile_uout.data() + 3*i_target);
+            for (uint i_image=0; i_image<images.n_images; ++i_image)
+            {
+                u_target += images.sign[i_image].cwiseProduct(
+                    Eigen::Map<const UVLM::Types::Vector3>(tile_uout.data() + 3*((1 + i_image)*n_tile + i_target)));
+            }
+            const uint i_row = order[first + i_target];
+            uout(i_row, 0) += u_target(0);
+            uout(i_row, 1) += u_target(1);
+            uout(i_row, 2) += u_target(2);
+        }
+    }
+}
+
+
+template <typename t_zeta_col,
+          typename t_u_ind>
+void UVLM::BiotSavart::SegmentTable::induced_velocities_on_surface
+(
+    const t_zeta_col& zeta_col,
+    t_u_ind& u_ind,
+    const UVLM::Types::MirrorImages& images
+) const
+{
+    const uint col_n_M = zeta_col[0].rows();
+    const uint col_n_N = zeta_col[0].cols();
+    UVLM::Types::MatrixX targets(col_n_M*col_n_N, UVLM::Constants::NDIM);
+    for (uint i_dim=0; i_dim<UVLM::Constants::NDIM; ++i_dim)
+    {
+        for (uint col_i_M=0; col_i_M<col_n_M; ++col_i_M)
+        {
+            for (uint col_j_N=0; col_j_N<col_n_N; ++col_j_N)
+            {
+                targets(col_i_M*col_n_N + col_j_N, i_dim) = zeta_col[i_dim](col_i_M, col_j_N);
+            }
+        }
+    }
+
+    UVLM::Types::MatrixX uout = UVLM::Types::MatrixX::Zero(col_n_M*col_n_N, UVLM::Constants::NDIM);
+    induced_velocities(targets, uout, images);
+
+    for (uint i_dim=0; i_dim<UVLM::Constants::NDIM; ++i_dim)
+    {
+        for (uint col_i_M=0; col_i_M<col_n_M; ++col_i_M)
+        {
+            for (uint col_j_N=0; col_j_N<col_n_N; ++col_j_N)
+            {
+                u_ind[i_dim](col_i_M, col_j_N) += uout(col_i_M*col_n_N + col_j_N, i_dim);
+            }
+        }
+    }
+}
+
+
+template <typename t_ttriad>
+UVLM::Types::Vector3 UVLM::BiotSavart::SegmentTable::induced_velocity
+(
+    const t_ttriad& target_triad,
+    const UVLM::Types::MirrorImages& images
+) const
+{
+    const UVLM::Types::Vector3 target = target_triad;
+    UVLM::Types::Vector3 uout = velocity(target);
+    for (uint i_image=0; i_image<images.n_images; ++i_image)
+    {
+        uout += images.sign[i_image].cwiseProduct(velocity(images.reflect(i_image, target)));
     }
     return uout;
 }
 
+
 template <typename t_zeta,
           typename t_zeta_star,
           typename t_gamma,
@@ -1193,34 +2686,30 @@ void UVLM::BiotSavart::total_induced_velocity_on_wake
     const t_gamma&      gamma,
     const t_gamma_star& gamma_star,
     t_uout&             uout,
-    const bool&         image_method,
+    const UVLM::Types::MirrorImages& images,
+    const bool          morton_order,
+    const bool          single_precision,
     const UVLM::Types::Real vortex_radius
 )
 {
     const uint n_surf = zeta.size();
+    // surfaces and wakes on wake, all the segments in one table
+    UVLM::BiotSavart::SegmentTable segments;
+    for (uint i_surf=0; i_surf<n_surf; ++i_surf)
+    {
+        segments.add_surface(zeta[i_surf],
+                             zeta_star[i_surf],
+                             gamma[i_surf],
+                             gamma_star[i_surf]);
+    }
+    if (morton_order) {segments.sort_morton();}
+    if (single_precision) {segments.use_single_precision();}
+
     for (uint col_i_surf=0; col_i_surf<n_surf; ++col_i_surf)
     {
-        for (uint i_surf=0; i_surf<n_surf; ++i_surf)
-        {
-            // wake on wake
-            UVLM::BiotSavart::whole_surface_on_surface
-            (
-                zeta_star[i_surf],
-                gamma_star[i_surf],
-                zeta_star[col_i_surf],
-                uout[col_i_surf],
-                image_method
-            );
-            // surface on wake
-            UVLM::BiotSavart::whole_surface_on_surface
-            (
-                zeta[i_surf],
-                gamma[i_surf],
-                zeta_star[col_i_surf],
-                uout[col_i_surf],
-                image_method
-            );
-        }
+        segments.induced_velocities_on_surface(zeta_star[col_i_surf],
+                                               uout[col_i_surf],
+                                               images);
     }
 }
 
@@ -1236,7 +2725,7 @@ UVLM::Types::Vector3 UVLM::BiotSavart::total_induced_velocity_on_point
     const t_zeta_star&  zeta_star,
     const t_gamma&      gamma,
     const t_gamma_star& gamma_star,
-    const bool&         image_method,
+    const UVLM::Types::MirrorImages& images,
     const UVLM::Types::Real vortex_radius
 )
 {
@@ -1256,7 +2745,7 @@ UVLM::Types::Vector3 UVLM::BiotSavart::total_induced_velocity_on_point
             0,
             -1,
             -1,
-            image_method,
+            images,
             vortex_radius
         );
         // surface on point
@@ -1270,7 +2759,7 @@ UVLM::Types::Vector3 UVLM::BiotSavart::total_induced_velocity_on_point
             0,
             -1,
             -1,
-            image_method,
+            images,
             vortex_radius
         );
     }
@@ -15,5 +15,9 @@ namespace UVLM
 
         const UVLM::Types::Real EPSILON =
                 10*std::numeric_limits<UVLM::Types::Real>::epsilon();
+
+        // Two lattices are considered to keep their relative pose if
+        // they match a rigid motion within this fraction of their size
+        const UVLM::Types::Real POSE_TOLERANCE = 1e-10;
     }
 }
@@ -0,0 +1,401 @@
+#pragma once
+
+#include "EigenInclude.h"
+#include "types.h"
+#include "constants.h"
+#include "matrix.h"
+#include "wake.h"
+
+#include <complex>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+// Steady helicoidal wake (SHW) solution of rotors with B identical blades
+// equally spaced around the rotation axis, one surface per blade.
+// The influence of blade k on blade j only depends on (k - j) mod B, so the
+// AIC is block circulant and it is defined by the influence of all the
+// blades on the reference blade (first block row, K x B*K).
+// The discrete Fourier transform in the blade index decouples the system
+// into B complex systems of size K, and only floor(B/2) + 1 of them are
+// independent for real data: the AIC is B times cheaper to assemble and the
+// factorisation is roughly B^2 times cheaper than the dense one.
+namespace UVLM
+{
+    namespace CyclicSymmetry
+    {
+        typedef std::complex<UVLM::Types::Real> Complex;
+        typedef Eigen::Matrix<Complex, Eigen::Dynamic, Eigen::Dynamic> MatrixXc;
+        typedef Eigen::Matrix<Complex, Eigen::Dynamic, 1> VectorXc;
+
+        UVLM::Types::Vector3 rotate
+        (
+            const UVLM::Types::Vector3& point,
+            const UVLM::Types::Vector3& rot_center,
+            const UVLM::Types::Vector3& rot_axis,
+            const UVLM::Types::Real angle
+        );
+
+        template <typename t_ref,
+                  typename t_blade>
+        bool is_rotated
+        (
+            const t_ref& ref,
+            const t_blade& blade,
+            const UVLM::Types::Vector3& rot_center,
+            const UVLM::Types::Vector3& rot_axis,
+            const UVLM::Types::Real angle,
+            const UVLM::Types::Real tolerance
+        );
+
+        template <typename t_zeta,
+                  typename t_zeta_star>
+        bool is_cyclic
+        (
+            const t_zeta& zeta,
+            const t_zeta_star& zeta_star,
+            const UVLM::Types::VMopts& options,
+            const UVLM::Types::SHWOptions& shwoptions
+        );
+
+        template <typename t_zeta,
+                  typename t_zeta_col,
+                  typename t_zeta_star,
+                  typename t_normals>
+        void reference_blade_AIC
+        (
+            const t_zeta& zeta,
+            const t_zeta_col& zeta_col,
+            const t_zeta_star& zeta_star,
+            const t_normals& normals,
+            const UVLM::Types::VMopts& options,
+            UVLM::Types::MatrixX& aic_row
+        );
+
+        void solve
+        (
+            const UVLM::Types::MatrixX& aic_row,
+            const UVLM::Types::VectorX& rhs,
+            UVLM::Types::VectorX& x
+        );
+
+        template <typename t_zeta,
+                  typename t_zeta_col,
+                  typename t_uext_col,
+                  typename t_zeta_star,
+                  typename t_gamma,
+                  typename t_gamma_star,
+                  typename t_normals>
+        bool solve_discretised
+        (
+            t_zeta& zeta,
+            t_zeta_col& zeta_col,
+            t_uext_col& uext_col,
+            t_zeta_star& zeta_star,
+            t_gamma& gamma,
+            t_gamma_star& gamma_star,
+            t_normals& normals,
+            const UVLM::Types::VMopts& options,
+            const UVLM::Types::SHWOptions& shwoptions
+        );
+    }
+}
+
+
+// Rotation of point by angle around rot_axis (unit) through rot_center
+UVLM::Types::Vector3 UVLM::CyclicSymmetry::rotate
+(
+    const UVLM::Types::Vector3& point,
+    const UVLM::Types::Vector3& rot_center,
+    const UVLM::Types::Vector3& rot_axis,
+    const UVLM::Types::Real angle
+)
+{
+    const UVLM::Types::Vector3 r = point - rot_center;
+    const UVLM::Types::Real c = std::cos(angle);
+    const UVLM::Types::Real s = std::sin(angle);
+    return rot_center + r*c + rot_axis.cross(r)*s + rot_axis*rot_axis.dot(r)*(1.0 - c);
+}
+
+
+// blade is ref rotated by angle (same number of grid points)
+template <typename t_ref,
+          typename t_blade>
+bool UVLM::CyclicSymmetry::is_rotated
+(
+    const t_ref& ref,
+    const t_blade& blade,
+    const UVLM::Types::Vector3& rot_center,
+    const UVLM::Types::Vector3& rot_axis,
+    const UVLM::Types::Real angle,
+    const UVLM::Types::Real tolerance
+)
+{
+    for (uint i=0; i<ref[0].rows(); ++i)
+    {
+        for (uint j=0; j<ref[0].cols(); ++j)
+        {
+            const UVLM::Types::Vector3 point(ref[0](i, j),
+                                             ref[1](i, j),
+                                             ref[2](i, j));
+            const UVLM::Types::Vector3 actual(blade[0](i, j),
+                                              blade[1](i, j),
+                                              blade[2](i, j));
+            if ((actual - rotate(point, rot_center, rot_axis, angle)).norm() > tolerance)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+
+/*-----------------------------------------------------------------------------
+True if every surface (bound lattice and wake) is the first one rotated by
+2*pi*k/n_surf (k the surface index, either sense of rotation) around the
+rotation axis of shwoptions. Mirror images break the symmetry.
+-----------------------------------------------------------------------------*/
+template <typename t_zeta,
+          typename t_zeta_star>
+bool UVLM::CyclicSymmetry::is_cyclic
+(
+    const t_zeta& zeta,
+    const t_zeta_star& zeta_star,
+    const UVLM::Types::VMopts& options,
+    const UVLM::Types::SHWOptions& shwoptions
+)
+{
+    const uint n_blades = options.NumSurfaces;
+    if (n_blades < 2 || options.ImageMethod || options.symmetry_condition)
+    {
+        return false;
+    }
+    for (uint i_surf=1; i_surf<n_blades; ++i_surf)
+    {
+        if (zeta[i_surf][0].rows() != zeta[0][0].rows() ||
+            zeta[i_surf][0].cols() != zeta[0][0].cols() ||
+            zeta_star[i_surf][0].rows() != zeta_star[0][0].rows() ||
+            zeta_star[i_surf][0].cols() != zeta_star[0][0].cols())
+        {
+            return false;
+        }
+    }
+
+    const UVLM::Types::Vector3 rot_center(shwoptions.rot_center);
+    UVLM::Types::Vector3 rot_axis(shwoptions.rot_axis);
+    if (rot_axis.norm() == 0.0)
+    {
+        return false;
+    }
+    rot_axis.normalize();
+
+    // tolerance relative to the size of the rotor and its wake
+    UVLM::Types::Real scale = 0.0;
+    for (uint i=0; i<zeta_star[0][0].rows(); ++i)
+    {
+        for (uint j=0; j<zeta_star[0][0].cols(); ++j)
+        {
+            const UVLM::Types::Vector3 point(zeta_star[0][0](i, j),
+                                             zeta_star[0][1](i, j),
+                                             zeta_star[0][2](i, j));
+            scale = std::max(scale, (point - rot_center).norm());
+        }
+    }
+    const UVLM::Types::Real tolerance = UVLM::Constants::POSE_TOLERANCE*
+                                        std::max(scale, 1.0);
+
+    const UVLM::Types::Real blade_angle = 2.0*UVLM::Constants::PI/n_blades;
+    for (int sense=1; sense>=-1; sense-=2)
+    {
+        bool matches = true;
+        for (uint i_surf=1; i_surf<n_blades && matches; ++i_surf)
+        {
+            const UVLM::Types::Real angle = sense*blade_angle*i_surf;
+            matches = is_rotated(zeta[0], zeta[i_surf], rot_center, rot_axis, angle, tolerance) &&
+                      is_rotated(zeta_star[0], zeta_star[i_surf], rot_center, rot_axis, angle, tolerance);
+        }
+        if (matches)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/*-----------------------------------------------------------------------------
+Influence of every blade (bound lattice plus steady wake on the trailing edge
+columns) on the collocation points of the reference blade (surface 0).
+Block d of aic_row (columns d*K to (d + 1)*K) is the influence of blade d.
+-----------------------------------------------------------------------------*/
+template <typename t_zeta,
+          typename t_zeta_col,
+          typename t_zeta_star,
+          typename t_normals>
+void UVLM::CyclicSymmetry::reference_blade_AIC
+(
+    const t_zeta& zeta,
+    const t_zeta_col& zeta_col,
+    const t_zeta_star& zeta_star,
+    const t_normals& normals,
+    const UVLM::Types::VMopts& options,
+    UVLM::Types::MatrixX& aic_row
+)
+{
+    const uint n_blades = options.NumSurfaces;
+    const uint M = zeta_col[0][0].rows();
+    const uint N = zeta_col[0][0].cols();
+    const uint K = M*N;
+    aic_row.setZero(K, n_blades*K);
+
+    #pragma omp parallel for collapse(2) schedule(dynamic)
+    for (uint i_col=0; i_col<K; ++i_col)
+    {
+        for (uint i_blade=0; i_blade<n_blades; ++i_blade)
+        {
+            UVLM::Types::Vector3 target_triad;
+            UVLM::Types::Vector3 normal;
+            target_triad << zeta_col[0][0](i_col/N, i_col%N),
+                            zeta_col[0][1](i_col/N, i_col%N),
+                            zeta_col[0][2](i_col/N, i_col%N);
+            normal << normals[0][0](i_col/N, i_col%N),
+                      normals[0][1](i_col/N, i_col%N),
+                      normals[0][2](i_col/N, i_col%N);
+            UVLM::Matrix::AIC_row
+            (
+                zeta[i_blade],
+                zeta_star[i_blade],
+                target_triad,
+                normal,
+                options,
+                false,
+                true,
+                options.Steady,
+                aic_row.block(i_col, i_blade*K, 1, K),
+                aic_row.block(i_col, i_blade*K + (M - 1)*N, 1, N)
+            );
+        }
+    }
+}
+
+
+/*-----------------------------------------------------------------------------
+Solution of the block circulant system with first block row aic_row:
+    sum_d C_d x_{(j + d) mod B} = b_j
+With the transforms b^_m = sum_j b_j w^(-m j), w = exp(2 pi i/B), every mode
+solves C^_m x^_m = b^_m, with C^_m = sum_d C_d w^(m d), and
+x_k = 1/B sum_m x^_m w^(m k). Mode B - m is the conjugate of mode m.
+-----------------------------------------------------------------------------*/
+void UVLM::CyclicSymmetry::solve
+(
+    const UVLM::Types::MatrixX& aic_row,
+    const UVLM::Types::VectorX& rhs,
+    UVLM::Types::VectorX& x
+)
+{
+    const uint K = aic_row.rows();
+    const uint n_blades = aic_row.cols()/K;
+    const uint n_modes = n_blades/2 + 1;
+    const UVLM::Types::Real blade_angle = 2.0*UVLM::Constants::PI/n_blades;
+
+    std::vector<VectorXc> x_modes(n_modes);
+    #pragma omp parallel for schedule(dynamic)
+    for (uint i_mode=0; i_mode<n_modes; ++i_mode)
+    {
+        MatrixXc aic_mode = MatrixXc::Zero(K, K);
+        VectorXc rhs_mode = VectorXc::Zero(K);
+        for (uint i_blade=0; i_blade<n_blades; ++i_blade)
+        {
+            const UVLM::Types::Real phase = blade_angle*((i_mode*i_blade)%n_blades);
+            const Complex w(std::cos(phase), std::sin(phase));
+            aic_mode += w*aic_row.block(0, i_blade*K, K, K).cast<Complex>();
+            rhs_mode += std::conj(w)*rhs.segment(i_blade*K, K).cast<Complex>();
+        }
+        x_modes[i_mode] = aic_mode.partialPivLu().solve(rhs_mode);
+    }
+
+    x.setZero(n_blades*K);
+    for (uint i_blade=0; i_blade<n_blades; ++i_blade)
+    {
+        for (uint i_mode=0; i_mode<n_modes; ++i_mode)
+        {
+            // modes without conjugate pair: 0 and B/2 (B even)
+            const UVLM::Types::Real weight = (i_mode == 0 || 2*i_mode == n_blades) ? 1.0 : 2.0;
+            const UVLM::Types::Real phase = blade_angle*((i_mode*i_blade)%n_blades);
+            const Complex w(std::cos(phase), std::sin(phase));
+            x.segment(i_blade*K, K) += weight/n_blades*(w*x_modes[i_mode]).real();
+        }
+    }
+}
+
+
+/*-----------------------------------------------------------------------------
+Steady SHW solution (as UVLM::Steady::solve_discretised) exploiting the
+cyclic symmetry of the rotor. Returns false, without modifying gamma, if the
+geometry is not cyclic.
+-----------------------------------------------------------------------------*/
+template <typename t_zeta,
+          typename t_zeta_col,
+          typename t_uext_col,
+          typename t_zeta_star,
+          typename t_gamma,
+          typename t_gamma_star,
+          typename t_normals>
+bool UVLM::CyclicSymmetry::solve_discretised
+(
+    t_zeta& zeta,
+    t_zeta_col& zeta_col,
+    t_uext_col& uext_col,
+    t_zeta_star& zeta_star,
+    t_gamma& gamma,
+    t_gamma_star& gamma_star,
+    t_normals& normals,
+    const UVLM::Types::VMopts& options,
+    const UVLM::Types::SHWOptions& shwoptions
+)
+{
+    if (!is_cyclic(zeta, zeta_star, options, shwoptions))
+    {
+        return false;
+    }
+
+    const uint n_surf = options.NumSurfaces;
+    uint Ktotal = 0;
+    for (uint i_surf=0; i_surf<n_surf; ++i_surf)
+    {
+        Ktotal += uext_col[i_surf][0].rows()*uext_col[i_surf][0].cols();
+    }
+
+    UVLM::Types::VectorX rhs;
+    UVLM::Matrix::RHS(zeta_col,
+                      zeta_star,
+                      uext_col,
+                      gamma_star,
+                      normals,
+                      options,
+                      rhs,
+                      Ktotal);
+
+    UVLM::Types::MatrixX aic_row;
+    reference_blade_AIC(zeta,
+                        zeta_col,
+                        zeta_star,
+                        normals,
+                        options,
+                        aic_row);
+
+    UVLM::Types::VectorX gamma_flat;
+    solve(aic_row, rhs, gamma_flat);
+
+    UVLM::Matrix::reconstruct_gamma(gamma_flat,
+                                    gamma,
+                                    zeta_col);
+    if (options.Steady)
+    {
+        UVLM::Wake::Horseshoe::circulation_transfer(gamma,
+                                                    gamma_star,
+                                                    -1);
+    }
+    return true;
+}
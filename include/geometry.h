@@ -168,6 +168,39 @@ namespace UVLM
         }
 
 
+        // Least-squares rigid motion (Kabsch algorithm) that maps the
+        // reference points onto the current ones:
+        // current ~= rotation*reference + translation
+        // Both sets of points are stored as columns of 3xn matrices.
+        // Returns the largest distance between the transformed reference
+        // and the current points.
+        UVLM::Types::Real rigid_transform
+        (
+            const UVLM::Types::MatrixX& reference,
+            const UVLM::Types::MatrixX& current,
+            UVLM::Types::Matrix3& rotation,
+            UVLM::Types::Vector3& translation
+        )
+        {
+            const UVLM::Types::Vector3 ref_centre = reference.rowwise().mean();
+            const UVLM::Types::Vector3 cur_centre = current.rowwise().mean();
+
+            UVLM::Types::Matrix3 covariance =
+                (reference.colwise() - ref_centre)*
+                (current.colwise() - cur_centre).transpose();
+            Eigen::JacobiSVD<UVLM::Types::Matrix3> svd(covariance,
+                                                        Eigen::ComputeFullU |
+                                                        Eigen::ComputeFullV);
+            // correction to avoid reflections
+            UVLM::Types::Matrix3 correction = UVLM::Types::Matrix3::Identity();
+            correction(2, 2) = (svd.matrixV()*svd.matrixU().transpose()).determinant() < 0.0 ? -1.0 : 1.0;
+            rotation = svd.matrixV()*correction*svd.matrixU().transpose();
+            translation = cur_centre - rotation*ref_centre;
+
+            return ((rotation*reference).colwise() + translation - current).colwise().norm().maxCoeff();
+        }
+
+
         template <typename t_in,
                   typename t_out>
         void generate_colocationMesh
@@ -0,0 +1,735 @@
+#pragma once
+
+#include "EigenInclude.h"
+#include "types.h"
+#include "krylov.h"
+
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <iostream>
+
+// Hierarchical matrix (H-matrix) representation of the AIC.
+// The collocation points are organised in a cluster tree; the blocks of
+// the matrix coupling well separated clusters are approximated by low
+// rank products obtained with adaptive cross approximation (ACA), and
+// only the near field is stored as dense blocks.
+// The entries are evaluated on demand through a functor with
+//      UVLM::Types::Real operator()(const uint row, const uint col)
+namespace UVLM
+{
+    namespace HMatrix
+    {
+        // maximum number of indices in a leaf of the cluster tree
+        const uint LEAF_SIZE = 32;
+        // admissibility parameter: two clusters are well separated if
+        // min(diameter) <= ADMISSIBILITY*distance
+        const UVLM::Types::Real ADMISSIBILITY = 1.0;
+        // maximum rank of the off-diagonal blocks of the preconditioner
+        const uint PRECONDITIONER_RANK = 16;
+        // relative tolerance of the preconditioner approximation
+        const UVLM::Types::Real PRECONDITIONER_TOLERANCE = 1e-2;
+        // tolerance used when none is given
+        const UVLM::Types::Real DEFAULT_TOLERANCE = 1e-8;
+
+        struct BoundingBox
+        {
+            UVLM::Types::Vector3 min;
+            UVLM::Types::Vector3 max;
+
+            BoundingBox()
+            {
+                min.setConstant(std::numeric_limits<UVLM::Types::Real>::max());
+                max.setConstant(-std::numeric_limits<UVLM::Types::Real>::max());
+            }
+
+            void extend(const UVLM::Types::Vector3& point)
+            {
+                min = min.cwiseMin(point);
+                max = max.cwiseMax(point);
+            }
+
+            void extend(const BoundingBox& box)
+            {
+                min = min.cwiseMin(box.min);
+                max = max.cwiseMax(box.max);
+            }
+
+            UVLM::Types::Real diameter() const
+            {
+                return (max - min).norm();
+            }
+
+            UVLM::Types::Real distance(const BoundingBox& box) const
+            {
+                const UVLM::Types::Vector3 gap =
+                    ((box.min - max).cwiseMax(min - box.max)).cwiseMax(0.0);
+                return gap.norm();
+            }
+        };
+
+        struct Cluster
+        {
+            uint begin;
+            uint end;
+            int children[2];
+            // box of the collocation points (rows) and of the
+            // vortex rings, wake included (columns)
+            BoundingBox row_box;
+            BoundingBox col_box;
+
+            uint size() const {return end - begin;}
+            bool is_leaf() const {return children[0] < 0;}
+        };
+
+        class ClusterTree
+        {
+        public:
+            // index[i] is the original index of the i-th element in
+            // the tree ordering
+            std::vector<uint> index;
+            std::vector<Cluster> nodes;
+
+            void build
+            (
+                const UVLM::Types::MatrixX& points,
+                const std::vector<BoundingBox>& source_boxes,
+                const uint leaf_size = LEAF_SIZE
+            );
+
+        private:
+            int split
+            (
+                const UVLM::Types::MatrixX& points,
+                const std::vector<BoundingBox>& source_boxes,
+                const uint begin,
+                const uint end,
+                const uint leaf_size
+            );
+        };
+
+        // block ~= U*V^T
+        struct LowRank
+        {
+            UVLM::Types::MatrixX U;
+            UVLM::Types::MatrixX V;
+        };
+
+        template <typename t_entry>
+        bool aca
+        (
+            const t_entry& entry,
+            const std::vector<uint>& rows,
+            const std::vector<uint>& cols,
+            const UVLM::Types::Real tolerance,
+            const uint max_rank,
+            LowRank& approximation
+        );
+
+        struct Block
+        {
+            uint row_node;
+            uint col_node;
+            bool low_rank;
+            UVLM::Types::MatrixX dense;
+            LowRank approximation;
+        };
+
+        class HMatrix
+        {
+        public:
+            ClusterTree tree;
+            std::vector<Block> blocks;
+
+            template <typename t_entry>
+            void assemble
+            (
+                const t_entry& entry,
+                const UVLM::Types::MatrixX& points,
+                const std::vector<BoundingBox>& source_boxes,
+                const UVLM::Types::Real tolerance
+            );
+
+            // y = A*x, in the original ordering
+            void multiply
+            (
+                const UVLM::Types::VectorX& x,
+                UVLM::Types::VectorX& y
+            ) const;
+
+            void operator()
+            (
+                const UVLM::Types::VectorX& x,
+                UVLM::Types::VectorX& y
+            ) const
+            {
+                multiply(x, y);
+            }
+
+            uint size() const {return tree.index.size();}
+            // number of stored reals (for comparison with size()^2)
+            unsigned long stored_entries() const;
+
+        private:
+            void partition
+            (
+                const uint row_node,
+                const uint col_node
+            );
+        };
+
+        // Recursive block LU factorisation on the cluster tree in which
+        // the off-diagonal blocks of every level are replaced by low rank
+        // approximations (of rank PRECONDITIONER_RANK at most).
+        // The Schur complements are low-rank corrections of the diagonal
+        // blocks and are applied with the Woodbury identity, so the
+        // factorisation is an approximate H-LU to be used as
+        // preconditioner.
+        class HLU
+        {
+        public:
+            template <typename t_entry>
+            void compute
+            (
+                const t_entry& entry,
+                const ClusterTree& tree,
+                const UVLM::Types::Real tolerance = PRECONDITIONER_TOLERANCE,
+                const uint max_rank = PRECONDITIONER_RANK
+            );
+
+            // x ~= A^{-1}*b, in the original ordering
+            void solve
+            (
+                const UVLM::Types::VectorX& b,
+                UVLM::Types::VectorX& x
+            ) const;
+
+            void operator()
+            (
+                const UVLM::Types::VectorX& b,
+                UVLM::Types::VectorX& x
+            ) const
+            {
+                solve(b, x);
+            }
+
+        private:
+            struct Node
+            {
+                Eigen::PartialPivLU<UVLM::Types::MatrixX> lu;
+                // A12 ~= P*Q^T, A21 ~= R*S^T
+                UVLM::Types::MatrixX P, Q, R, S;
+                // W = A11^{-1}*P, Y = A22^{-1}*R, C = S^T*W
+                UVLM::Types::MatrixX W, Y, C;
+                Eigen::PartialPivLU<UVLM::Types::MatrixX> capacitance;
+            };
+            const ClusterTree* tree = NULL;
+            std::vector<Node> nodes;
+
+            void solve_node
+            (
+                const uint i_node,
+                UVLM::Types::MatrixX& b
+            ) const;
+        };
+
+        template <typename t_entry>
+        uint solve
+        (
+            const t_entry& entry,
+            const UVLM::Types::VectorX& rhs,
+            UVLM::Types::Real tolerance,
+            UVLM::Types::VectorX& x
+        );
+    }
+}
+
+
+/*-----------------------------------------------------------------------------
+Cluster tree
+-----------------------------------------------------------------------------*/
+void UVLM::HMatrix::ClusterTree::build
+(
+    const UVLM::Types::MatrixX& points,
+    const std::vector<BoundingBox>& source_boxes,
+    const uint leaf_size
+)
+{
+    const uint K = points.cols();
+    index.resize(K);
+    for (uint i=0; i<K; ++i)
+    {
+        index[i] = i;
+    }
+    nodes.clear();
+    split(points, source_boxes, 0, K, leaf_size);
+}
+
+
+// Bisection of the points along the largest dimension of their
+// bounding box. Returns the node number.
+int UVLM::HMatrix::ClusterTree::split
+(
+    const UVLM::Types::MatrixX& points,
+    const std::vector<BoundingBox>& source_boxes,
+    const uint begin,
+    const uint end,
+    const uint leaf_size
+)
+{
+    const uint i_node = nodes.size();
+    nodes.push_back(Cluster());
+    Cluster cluster;
+    cluster.begin = begin;
+    cluster.end = end;
+    cluster.children[0] = -1;
+    cluster.children[1] = -1;
+    for (uint i=begin; i<end; ++i)
+    {
+        cluster.row_box.extend(UVLM::Types::Vector3(points.col(index[i])));
+        cluster.col_box.extend(source_boxes[index[i]]);
+    }
+
+    if (end - begin > leaf_size)
+    {
+        uint i_dim;
+        (cluster.row_box.max - cluster.row_box.min).maxCoeff(&i_dim);
+        const uint middle = begin + (end - begin)/2;
+        std::nth_element(index.begin() + begin,
+                         index.begin() + middle,
+                         index.begin() + end,
+                         [&points, i_dim](const uint a, const uint b)
+                         {
+                             return points(i_dim, a) < points(i_dim, b);
+                         });
+        cluster.children[0] = split(points, source_boxes, begin, middle, leaf_size);
+        cluster.children[1] = split(points, source_boxes, middle, end, leaf_size);
+    }
+    nodes[i_node] = cluster;
+    return i_node;
+}
+
+
+/*-----------------------------------------------------------------------------
+Adaptive cross approximation with partial pivoting.
+Returns false if the tolerance was not reached with max_rank terms.
+-----------------------------------------------------------------------------*/
+template <typename t_entry>
+bool UVLM::HMatrix::aca
+(
+    const t_entry& entry,
+    const std::vector<uint>& rows,
+    const std::vector<uint>& cols,
+    const UVLM::Types::Real tolerance,
+    const uint max_rank,
+    LowRank& approximation
+)
+{
+    const uint m = rows.size();
+    const uint n = cols.size();
+    const uint rank_limit = std::min(max_rank, std::min(m, n));
+    UVLM::Types::MatrixX U(m, rank_limit);
+    UVLM::Types::MatrixX V(n, rank_limit);
+    std::vector<bool> used_row(m, false);
+
+    UVLM::Types::Real norm_sq = 0.0;
+    uint rank = 0;
+    uint pivot_row = 0;
+    bool converged = false;
+    UVLM::Types::VectorX row(n);
+    UVLM::Types::VectorX col(m);
+    while (rank < rank_limit)
+    {
+        used_row[pivot_row] = true;
+        for (uint j=0; j<n; ++j)
+        {
+            row(j) = entry(rows[pivot_row], cols[j]);
+        }
+        row -= V.leftCols(rank)*U.row(pivot_row).head(rank).transpose();
+
+        uint pivot_col;
+        const UVLM::Types::Real pivot = row.cwiseAbs().maxCoeff(&pivot_col);
+        if (pivot > 0.0)
+        {
+            for (uint i=0; i<m; ++i)
+            {
+                col(i) = entry(rows[i], cols[pivot_col]);
+            }
+            col -= U.leftCols(rank)*V.row(pivot_col).head(rank).transpose();
+
+            const UVLM::Types::VectorX v = row/row(pivot_col);
+            // update of the Frobenius norm of the approximation
+            for (uint l=0; l<rank; ++l)
+            {
+                norm_sq += 2.0*col.dot(U.col(l))*v.dot(V.col(l));
+            }
+            const UVLM::Types::Real term_sq = col.squaredNorm()*v.squaredNorm();
+            norm_sq += term_sq;
+            U.col(rank) = col;
+            V.col(rank) = v;
+            ++rank;
+
+            if (term_sq <= tolerance*tolerance*norm_sq)
+            {
+                converged = true;
+                break;
+            }
+        }
+
+        // next pivot: largest entry of the last column among the
+        // rows not used yet
+        UVLM::Types::Real largest = -1.0;
+        bool found = false;
+        for (uint i=0; i<m; ++i)
+        {
+            if (used_row[i]) {continue;}
+            const UVLM::Types::Real value = (rank > 0) ? std::abs(U(i, rank - 1)) : 0.0;
+            if (value > largest)
+            {
+                largest = value;
+                pivot_row = i;
+                found = true;
+            }
+        }
+        if (!found)
+        {
+            // all the rows were used, the approximation is exact
+            converged = true;
+            break;
+        }
+    }
+
+    approximation.U = U.leftCols(rank);
+    approximation.V = V.leftCols(rank);
+    return converged;
+}
+
+
+/*-----------------------------------------------------------------------------
+HMatrix
+-----------------------------------------------------------------------------*/
+void UVLM::HMatrix::HMatrix::partition
+(
+    const uint row_node,
+    const uint col_node
+)
+{
+    const Cluster& row_cluster = tree.nodes[row_node];
+    const Cluster& col_cluster = tree.nodes[col_node];
+
+    Block block;
+    block.row_node = row_node;
+    block.col_node = col_node;
+    const UVLM::Types::Real diameter = std::min(row_cluster.row_box.diameter(),
+                                                col_cluster.col_box.diameter());
+    if (diameter <= ADMISSIBILITY*row_cluster.row_box.distance(col_cluster.col_box))
+    {
+        block.low_rank = true;
+        blocks.push_back(block);
+        return;
+    }
+    if (row_cluster.is_leaf() && col_cluster.is_leaf())
+    {
+        block.low_rank = false;
+        blocks.push_back(block);
+        return;
+    }
+
+    if (row_cluster.is_leaf())
+    {
+        partition(row_node, col_cluster.children[0]);
+        partition(row_node, col_cluster.children[1]);
+    } else if (col_cluster.is_leaf())
+    {
+        partition(row_cluster.children[0], col_node);
+        partition(row_cluster.children[1], col_node);
+    } else
+    {
+        for (uint i=0; i<2; ++i)
+        {
+            for (uint j=0; j<2; ++j)
+            {
+                partition(row_cluster.children[i], col_cluster.children[j]);
+            }
+        }
+    }
+}
+
+
+template <typename t_entry>
+void UVLM::HMatrix::HMatrix::assemble
+(
+    const t_entry& entry,
+    const UVLM::Types::MatrixX& points,
+    const std::vector<BoundingBox>& source_boxes,
+    const UVLM::Types::Real tolerance
+)
+{
+    tree.build(points, source_boxes);
+    blocks.clear();
+    partition(0, 0);
+
+    const uint n_blocks = blocks.size();
+    #pragma omp parallel for schedule(dynamic)
+    for (uint i_block=0; i_block<n_blocks; ++i_block)
+    {
+        Block& block = blocks[i_block];
+        const Cluster& row_cluster = tree.nodes[block.row_node];
+        const Cluster& col_cluster = tree.nodes[block.col_node];
+        const std::vector<uint> rows(tree.index.begin() + row_cluster.begin,
+                                     tree.index.begin() + row_cluster.end);
+        const std::vector<uint> cols(tree.index.begin() + col_cluster.begin,
+                                     tree.index.begin() + col_cluster.end);
+        if (block.low_rank)
+        {
+            // the approximation is only worth it if it takes less
+            // memory than the dense block
+            const uint max_rank = (rows.size()*cols.size())/(rows.size() + cols.size());
+            if (UVLM::HMatrix::aca(entry,
+                                   rows,
+                                   cols,
+                                   tolerance,
+                                   max_rank,
+                                   block.approximation))
+            {
+                continue;
+            }
+            block.low_rank = false;
+            block.approximation = LowRank();
+        }
+        block.dense.resize(rows.size(), cols.size());
+        for (uint i=0; i<rows.size(); ++i)
+        {
+            for (uint j=0; j<cols.size(); ++j)
+            {
+                block.dense(i, j) = entry(rows[i], cols[j]);
+            }
+        }
+    }
+}
+
+
+void UVLM::HMatrix::HMatrix::multiply
+(
+    const UVLM::Types::VectorX& x,
+    UVLM::Types::VectorX& y
+) const
+{
+    const uint K = size();
+    UVLM::Types::VectorX x_tree(K);
+    for (uint i=0; i<K; ++i)
+    {
+        x_tree(i) = x(tree.index[i]);
+    }
+    UVLM::Types::VectorX y_tree = UVLM::Types::VectorX::Zero(K);
+
+    const uint n_blocks = blocks.size();
+    #pragma omp parallel
+    {
+        UVLM::Types::VectorX y_private = UVLM::Types::VectorX::Zero(K);
+        #pragma omp for schedule(dynamic)
+        for (uint i_block=0; i_block<n_blocks; ++i_block)
+        {
+            const Block& block = blocks[i_block];
+            const Cluster& row_cluster = tree.nodes[block.row_node];
+            const Cluster& col_cluster = tree.nodes[block.col_node];
+            if (block.low_rank)
+            {
+                y_private.segment(row_cluster.begin, row_cluster.size()) +=
+                    block.approximation.U*(block.approximation.V.transpose()*
+                        x_tree.segment(col_cluster.begin, col_cluster.size()));
+            } else
+            {
+                y_private.segment(row_cluster.begin, row_cluster.size()) +=
+                    block.dense*x_tree.segment(col_cluster.begin, col_cluster.size());
+            }
+        }
+        #pragma omp critical
+        y_tree += y_private;
+    }
+
+    y.resize(K);
+    for (uint i=0; i<K; ++i)
+    {
+        y(tree.index[i]) = y_tree(i);
+    }
+}
+
+
+unsigned long UVLM::HMatrix::HMatrix::stored_entries() const
+{
+    unsigned long n_entries = 0;
+    for (uint i_block=0; i_block<blocks.size(); ++i_block)
+    {
+        n_entries += blocks[i_block].dense.size() +
+                     blocks[i_block].approximation.U.size() +
+                     blocks[i_block].approximation.V.size();
+    }
+    return n_entries;
+}
+
+
+/*-----------------------------------------------------------------------------
+HLU preconditioner
+-----------------------------------------------------------------------------*/
+template <typename t_entry>
+void UVLM::HMatrix::HLU::compute
+(
+    const t_entry& entry,
+    const ClusterTree& in_tree,
+    const UVLM::Types::Real tolerance,
+    const uint max_rank
+)
+{
+    tree = &in_tree;
+    const uint n_nodes = tree->nodes.size();
+    nodes.clear();
+    nodes.resize(n_nodes);
+
+    // children are always numbered after their parent, so going
+    // backwards through the nodes factorises the children first
+    for (int i_node=n_nodes - 1; i_node>=0; --i_node)
+    {
+        const Cluster& cluster = tree->nodes[i_node];
+        Node& node = nodes[i_node];
+        const std::vector<uint> indices(tree->index.begin() + cluster.begin,
+                                        tree->index.begin() + cluster.end);
+        if (cluster.is_leaf())
+        {
+            UVLM::Types::MatrixX dense(indices.size(), indices.size());
+            for (uint i=0; i<indices.size(); ++i)
+            {
+                for (uint j=0; j<indices.size(); ++j)
+                {
+                    dense(i, j) = entry(indices[i], indices[j]);
+                }
+            }
+            node.lu.compute(dense);
+            continue;
+        }
+
+        const Cluster& first = tree->nodes[cluster.children[0]];
+        const Cluster& second = tree->nodes[cluster.children[1]];
+        const std::vector<uint> first_indices(tree->index.begin() + first.begin,
+                                              tree->index.begin() + first.end);
+        const std::vector<uint> second_indices(tree->index.begin() + second.begin,
+                                               tree->index.begin() + second.end);
+        LowRank upper;
+        LowRank lower;
+        UVLM::HMatrix::aca(entry, first_indices, second_indices, tolerance, max_rank, upper);
+        UVLM::HMatrix::aca(entry, second_indices, first_indices, tolerance, max_rank, lower);
+        node.P = upper.U;
+        node.Q = upper.V;
+        node.R = lower.U;
+        node.S = lower.V;
+
+        node.W = node.P;
+        solve_node(cluster.children[0], node.W);
+        node.Y = node.R;
+        solve_node(cluster.children[1], node.Y);
+        node.C = node.S.transpose()*node.W;
+
+        const uint rank = node.P.cols();
+        if ((rank > 0) && (node.R.cols() > 0))
+        {
+            node.capacitance.compute(UVLM::Types::MatrixX::Identity(rank, rank) -
+                                     node.Q.transpose()*node.Y*node.C);
+        }
+    }
+}
+
+
+// In-place solution of the diagonal block of a node, with b in the
+// tree ordering
+void UVLM::HMatrix::HLU::solve_node
+(
+    const uint i_node,
+    UVLM::Types::MatrixX& b
+) const
+{
+    const Cluster& cluster = tree->nodes[i_node];
+    const Node& node = nodes[i_node];
+    if (cluster.is_leaf())
+    {
+        b = node.lu.solve(b);
+        return;
+    }
+
+    const uint n1 = tree->nodes[cluster.children[0]].size();
+    const uint n2 = tree->nodes[cluster.children[1]].size();
+    UVLM::Types::MatrixX x1 = b.topRows(n1);
+    solve_node(cluster.children[0], x1);
+    UVLM::Types::MatrixX x2 = b.bottomRows(n2) - node.R*(node.S.transpose()*x1);
+
+    // Schur complement A22 - R*C*Q^T (Woodbury identity)
+    solve_node(cluster.children[1], x2);
+    if ((node.P.cols() > 0) && (node.R.cols() > 0))
+    {
+        x2 += node.Y*(node.C*node.capacitance.solve(node.Q.transpose()*x2));
+    }
+    if (node.P.cols() > 0)
+    {
+        x1 -= node.W*(node.Q.transpose()*x2);
+    }
+    b.topRows(n1) = x1;
+    b.bottomRows(n2) = x2;
+}
+
+
+void UVLM::HMatrix::HLU::solve
+(
+    const UVLM::Types::VectorX& b,
+    UVLM::Types::VectorX& x
+) const
+{
+    const uint K = tree->index.size();
+    UVLM::Types::MatrixX b_tree(K, 1);
+    for (uint i=0; i<K; ++i)
+    {
+        b_tree(i, 0) = b(tree->index[i]);
+    }
+    solve_node(0, b_tree);
+    x.resize(K);
+    for (uint i=0; i<K; ++i)
+    {
+        x(tree->index[i]) = b_tree(i, 0);
+    }
+}
+
+
+/*-----------------------------------------------------------------------------
+Solution of the system with the compressed matrix: GMRES preconditioned
+with the approximate H-LU. x is used as initial guess.
+The same relative tolerance is used for the compression and for GMRES.
+entry has to provide the collocation points (points()) and the extent of
+every vortex ring (source_boxes()).
+-----------------------------------------------------------------------------*/
+template <typename t_entry>
+uint UVLM::HMatrix::solve
+(
+    const t_entry& entry,
+    const UVLM::Types::VectorX& rhs,
+    UVLM::Types::Real tolerance,
+    UVLM::Types::VectorX& x
+)
+{
+    if (tolerance <= 0.0)
+    {
+        tolerance = DEFAULT_TOLERANCE;
+    }
+    UVLM::HMatrix::HMatrix aic;
+    aic.assemble(entry,
+                 entry.points(),
+                 entry.source_boxes(),
+                 tolerance);
+
+    UVLM::HMatrix::HLU preconditioner;
+    preconditioner.compute(entry, aic.tree);
+
+    return UVLM::Krylov::gmres(aic,
+                               preconditioner,
+                               rhs,
+                               x,
+                               tolerance);
+}
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+// Runtime selection of the instruction set of the hot kernels.
+// The library is compiled for the baseline x86-64 ISA (see src/Makefile),
+// but the callers of the kernels that dominate the run time wrap them in
+// a lambda and pass it to dispatch, which runs it through a variant
+// compiled for AVX2+FMA or AVX-512 when the CPU supports it. The variants
+// are flattened: the lambda and everything it calls is inlined in them,
+// so the whole kernel is compiled (and vectorised) for that ISA.
+// The environment variable UVLM_ISA (generic, avx2 or avx512) caps the
+// selection. Only with GCC or clang on x86-64; elsewhere, or with
+// -DUVLM_NO_ISA_DISPATCH, dispatch calls the lambda directly.
+#if defined(__GNUC__) && defined(__x86_64__) && !defined(UVLM_NO_ISA_DISPATCH)
+    #define UVLM_ISA_DISPATCH
+    #define UVLM_ISA_AVX2 __attribute__((target("avx2,fma"), flatten, noinline))
+    #define UVLM_ISA_AVX512 __attribute__((target("avx512f,avx512dq,avx512vl,avx512bw,avx2,fma"), flatten, noinline))
+#endif
+
+namespace UVLM
+{
+    namespace ISA
+    {
+        enum Level
+        {
+            generic = 0,
+            avx2 = 1,
+            avx512 = 2
+        };
+
+        const char* name
+        (
+            const Level level
+        );
+
+        // best level supported by the CPU, capped by UVLM_ISA
+        Level detect();
+
+        // detect(), evaluated once
+        Level level();
+
+        template <typename t_function>
+        void dispatch
+        (
+            t_function function
+        );
+
+#ifdef UVLM_ISA_DISPATCH
+        template <typename t_function>
+        UVLM_ISA_AVX2 void run_avx2
+        (
+            t_function& function
+        );
+
+        template <typename t_function>
+        UVLM_ISA_AVX512 void run_avx512
+        (
+            t_function& function
+        );
+#endif
+    }
+}
+
+
+inline const char* UVLM::ISA::name
+(
+    const UVLM::ISA::Level level
+)
+{
+    switch (level)
+    {
+        case UVLM::ISA::avx2:
+            return "avx2";
+        case UVLM::ISA::avx512:
+            return "avx512";
+        default:
+            return "generic";
+    }
+}
+
+
+inline UVLM::ISA::Level UVLM::ISA::detect()
+{
+    UVLM::ISA::Level detected = UVLM::ISA::generic;
+#ifdef UVLM_ISA_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    {
+        detected = UVLM::ISA::avx2;
+        if (__builtin_cpu_supports("avx512f") &&
+            __builtin_cpu_supports("avx512dq") &&
+            __builtin_cpu_supports("avx512vl") &&
+            __builtin_cpu_supports("avx512bw"))
+        {
+            detected = UVLM::ISA::avx512;
+        }
+    }
+#endif
+
+    const char* requested = std::getenv("UVLM_ISA");
+    if (requested)
+    {
+        UVLM::ISA::Level cap = detected;
+        bool known = false;
+        for (int i_level=UVLM::ISA::generic; i_level<=UVLM::ISA::avx512; ++i_level)
+        {
+            if (std::strcmp(requested, UVLM::ISA::name(UVLM::ISA::Level(i_level))) == 0)
+            {
+                cap = UVLM::ISA::Level(i_level);
+                known = true;
+            }
+        }
+        if (!known)
+        {
+            std::cerr << "WARNING: unknown UVLM_ISA " << requested
+                      << ", using " << UVLM::ISA::name(detected) << std::endl;
+        }
+        if (cap < detected)
+        {
+            detected = cap;
+        }
+    }
+    return detected;
+}
+
+
+inline UVLM::ISA::Level UVLM::ISA::level()
+{
+    static const UVLM::ISA::Level detected = UVLM::ISA::detect();
+    return detected;
+}
+
+
+#ifdef UVLM_ISA_DISPATCH
+template <typename t_function>
+UVLM_ISA_AVX2 void UVLM::ISA::run_avx2
+(
+    t_function& function
+)
+{
+    function();
+}
+
+
+template <typename t_function>
+UVLM_ISA_AVX512 void UVLM::ISA::run_avx512
+(
+    t_function& function
+)
+{
+    function();
+}
+#endif
+
+
+template <typename t_function>
+inline void UVLM::ISA::dispatch
+(
+    t_function function
+)
+{
+#ifdef UVLM_ISA_DISPATCH
+    switch (UVLM::ISA::level())
+    {
+        case UVLM::ISA::avx512:
+            UVLM::ISA::run_avx512(function);
+            return;
+        case UVLM::ISA::avx2:
+            UVLM::ISA::run_avx2(function);
+            return;
+        default:
+            break;
+    }
+#endif
+    function();
+}
@@ -0,0 +1,448 @@
+#pragma once
+
+#include "EigenInclude.h"
+#include "types.h"
+
+#include <cmath>
+#include <iostream>
+
+// Krylov solvers for systems that are only available as an operator
+// (the matrix-vector product) and not as an assembled matrix.
+namespace UVLM
+{
+    namespace Krylov
+    {
+        // Identity preconditioner
+        struct IdentityPreconditioner
+        {
+            void operator()
+            (
+                const UVLM::Types::VectorX& in,
+                UVLM::Types::VectorX& out
+            ) const
+            {
+                out = in;
+            }
+        };
+
+        // Tolerance used when none is given
+        const UVLM::Types::Real DEFAULT_TOLERANCE = 1e-10;
+        // Size of the Krylov space of GCRO-DR, recycled space included,
+        // and size of the recycled space
+        const uint RECYCLE_RESTART = 40;
+        const uint RECYCLE_DIMENSION = 10;
+
+        template <typename t_operator,
+                  typename t_preconditioner>
+        uint gmres
+        (
+            const t_operator& a,
+            const t_preconditioner& preconditioner,
+            const UVLM::Types::VectorX& b,
+            UVLM::Types::VectorX& x,
+            const UVLM::Types::Real tolerance,
+            const uint max_iterations = 500,
+            const uint restart = 50
+        );
+
+        template <typename t_operator,
+                  typename t_preconditioner>
+        uint gcrodr
+        (
+            const t_operator& a,
+            const t_preconditioner& preconditioner,
+            const UVLM::Types::VectorX& b,
+            UVLM::Types::VectorX& x,
+            UVLM::Types::MatrixX& recycle,
+            const UVLM::Types::Real tolerance,
+            const uint max_iterations = 500,
+            const uint restart = RECYCLE_RESTART,
+            const uint n_recycle = RECYCLE_DIMENSION
+        );
+
+        void orthonormalise_recycled
+        (
+            UVLM::Types::MatrixX& C,
+            UVLM::Types::MatrixX& U
+        );
+    }
+}
+
+
+/*-----------------------------------------------------------------------------
+Restarted GMRES with right preconditioning.
+a(in, out) computes out = A*in, and preconditioner(in, out) an approximation
+of out = A^{-1}*in. x is used as initial guess.
+Returns the number of iterations (matrix-vector products).
+-----------------------------------------------------------------------------*/
+template <typename t_operator,
+          typename t_preconditioner>
+uint UVLM::Krylov::gmres
+(
+    const t_operator& a,
+    const t_preconditioner& preconditioner,
+    const UVLM::Types::VectorX& b,
+    UVLM::Types::VectorX& x,
+    const UVLM::Types::Real tolerance,
+    const uint max_iterations,
+    const uint restart
+)
+{
+    const uint K = b.size();
+    if (x.size() != K)
+    {
+        x.setZero(K);
+    }
+    const UVLM::Types::Real b_norm = b.norm();
+    if (b_norm == 0.0)
+    {
+        x.setZero(K);
+        return 0;
+    }
+
+    const uint m = std::min(restart, K);
+    UVLM::Types::MatrixX basis(K, m + 1);
+    UVLM::Types::MatrixX hessenberg(m + 1, m);
+    UVLM::Types::VectorX cs(m);
+    UVLM::Types::VectorX sn(m);
+    UVLM::Types::VectorX g(m + 1);
+    UVLM::Types::VectorX w(K);
+    UVLM::Types::VectorX z(K);
+
+    uint n_iter = 0;
+    while (n_iter < max_iterations)
+    {
+        a(x, w);
+        UVLM::Types::VectorX r = b - w;
+        UVLM::Types::Real beta = r.norm();
+        if (beta <= tolerance*b_norm)
+        {
+            return n_iter;
+        }
+        basis.col(0) = r/beta;
+        hessenberg.setZero();
+        g.setZero();
+        g(0) = beta;
+
+        uint k = 0;
+        for (; k<m && n_iter<max_iterations; ++k)
+        {
+            ++n_iter;
+            preconditioner(basis.col(k), z);
+            a(z, w);
+            // modified Gram-Schmidt
+            for (uint i=0; i<=k; ++i)
+            {
+                hessenberg(i, k) = basis.col(i).dot(w);
+                w -= hessenberg(i, k)*basis.col(i);
+            }
+            hessenberg(k + 1, k) = w.norm();
+            if (hessenberg(k + 1, k) > 0.0)
+            {
+                basis.col(k + 1) = w/hessenberg(k + 1, k);
+            }
+
+            // apply the previous rotations to the new column
+            for (uint i=0; i<k; ++i)
+            {
+                const UVLM::Types::Real temp = cs(i)*hessenberg(i, k) + sn(i)*hessenberg(i + 1, k);
+                hessenberg(i + 1, k) = -sn(i)*hessenberg(i, k) + cs(i)*hessenberg(i + 1, k);
+                hessenberg(i, k) = temp;
+            }
+            // new rotation
+            const UVLM::Types::Real denominator = std::sqrt(hessenberg(k, k)*hessenberg(k, k) +
+                                                            hessenberg(k + 1, k)*hessenberg(k + 1, k));
+            cs(k) = (denominator == 0.0) ? 1.0 : hessenberg(k, k)/denominator;
+            sn(k) = (denominator == 0.0) ? 0.0 : hessenberg(k + 1, k)/denominator;
+            hessenberg(k, k) = denominator;
+            hessenberg(k + 1, k) = 0.0;
+            g(k + 1) = -sn(k)*g(k);
+            g(k) = cs(k)*g(k);
+
+            if (std::abs(g(k + 1)) <= tolerance*b_norm)
+            {
+                ++k;
+                break;
+            }
+        }
+
+        // update of the solution
+        const UVLM::Types::VectorX y =
+            hessenberg.topLeftCorner(k, k).triangularView<Eigen::Upper>().solve(g.head(k));
+        preconditioner(basis.leftCols(k)*y, z);
+        x += z;
+        if (std::abs(g(k)) <= tolerance*b_norm)
+        {
+            return n_iter;
+        }
+    }
+    std::cerr << "GMRES did not converge in "
+              << max_iterations
+              << " iterations" << std::endl;
+    return n_iter;
+}
+
+
+/*-----------------------------------------------------------------------------
+Makes C orthonormal (thin QR, C = Q*R) and applies the same change of basis
+to U, so that A*U = C still holds. Columns that are (numerically) linearly
+dependent on the previous ones are dropped.
+-----------------------------------------------------------------------------*/
+void UVLM::Krylov::orthonormalise_recycled
+(
+    UVLM::Types::MatrixX& C,
+    UVLM::Types::MatrixX& U
+)
+{
+    const uint K = C.rows();
+    uint k = C.cols();
+    const Eigen::HouseholderQR<Eigen::MatrixXd> qr(C);
+    const Eigen::MatrixXd R = qr.matrixQR().topRows(k).triangularView<Eigen::Upper>();
+    const UVLM::Types::Real largest = R.diagonal().cwiseAbs().maxCoeff();
+    for (uint i=0; i<k; ++i)
+    {
+        if (std::abs(R(i, i)) <= 1e-12*largest)
+        {
+            k = i;
+            break;
+        }
+    }
+    const Eigen::MatrixXd Q = qr.householderQ()*Eigen::MatrixXd::Identity(K, k);
+    C = Q;
+    U = R.topLeftCorner(k, k).triangularView<Eigen::Upper>()
+            .solve<Eigen::OnTheRight>(Eigen::MatrixXd(U.leftCols(k)));
+}
+
+
+/*-----------------------------------------------------------------------------
+GCRO-DR: restarted GMRES with deflated restarting and recycling of the
+deflation space between systems (Parks et al., 2006).
+recycle holds the recycled space U from the previous call (ignored if its
+size does not match) and is updated on exit. The system is
+right-preconditioned, the recycled space lives in the preconditioned space.
+Returns the number of iterations (Arnoldi steps).
+-----------------------------------------------------------------------------*/
+template <typename t_operator,
+          typename t_preconditioner>
+uint UVLM::Krylov::gcrodr
+(
+    const t_operator& a,
+    const t_preconditioner& preconditioner,
+    const UVLM::Types::VectorX& b,
+    UVLM::Types::VectorX& x,
+    UVLM::Types::MatrixX& recycle,
+    const UVLM::Types::Real tolerance,
+    const uint max_iterations,
+    const uint restart,
+    const uint n_recycle
+)
+{
+    const uint K = b.size();
+    if (x.size() != K)
+    {
+        x.setZero(K);
+    }
+    const UVLM::Types::Real b_norm = b.norm();
+    if (b_norm == 0.0)
+    {
+        x.setZero(K);
+        return 0;
+    }
+
+    UVLM::Types::VectorX w(K);
+    UVLM::Types::VectorX z(K);
+    // preconditioned operator
+    auto apply = [&](const UVLM::Types::VectorX& in, UVLM::Types::VectorX& out)
+    {
+        preconditioner(in, z);
+        a(z, out);
+    };
+
+    a(x, w);
+    UVLM::Types::VectorX r = b - w;
+
+    // A*U = C, with C orthonormal
+    UVLM::Types::MatrixX U;
+    UVLM::Types::MatrixX C;
+    if ((recycle.rows() == K) &&
+        (recycle.cols() > 0) &&
+        (recycle.cols() < std::min(restart, K)))
+    {
+        U = recycle;
+        C.resize(K, U.cols());
+        for (uint i=0; i<U.cols(); ++i)
+        {
+            apply(U.col(i), w);
+            C.col(i) = w;
+        }
+        UVLM::Krylov::orthonormalise_recycled(C, U);
+        // projection of the residual on the recycled space
+        const UVLM::Types::VectorX c = C.transpose()*r;
+        preconditioner(U*c, w);
+        x += w;
+        r -= C*c;
+    }
+
+    uint n_iter = 0;
+    while (n_iter < max_iterations)
+    {
+        const UVLM::Types::Real beta = r.norm();
+        if (beta <= tolerance*b_norm)
+        {
+            break;
+        }
+        const uint k = U.cols();
+        const uint m = std::min(restart, K) - k;
+
+        UVLM::Types::MatrixX V(K, m + 1);
+        UVLM::Types::MatrixX H = UVLM::Types::MatrixX::Zero(m + 1, m);
+        UVLM::Types::MatrixX B = UVLM::Types::MatrixX::Zero(k, m);
+        // rotated copy of H for the least squares problem
+        UVLM::Types::MatrixX H_rot = H;
+        UVLM::Types::VectorX cs(m);
+        UVLM::Types::VectorX sn(m);
+        UVLM::Types::VectorX g = UVLM::Types::VectorX::Zero(m + 1);
+        g(0) = beta;
+        V.col(0) = r/beta;
+
+        uint j = 0;
+        for (; j<m && n_iter<max_iterations; ++j)
+        {
+            ++n_iter;
+            apply(V.col(j), w);
+            // orthogonalisation against the recycled space and the
+            // Krylov basis
+            if (k > 0)
+            {
+                B.col(j) = C.transpose()*w;
+                w -= C*B.col(j);
+            }
+            for (uint i=0; i<=j; ++i)
+            {
+                H(i, j) = V.col(i).dot(w);
+                w -= H(i, j)*V.col(i);
+            }
+            H(j + 1, j) = w.norm();
+            if (H(j + 1, j) > 0.0)
+            {
+                V.col(j + 1) = w/H(j + 1, j);
+            } else
+            {
+                V.col(j + 1).setZero();
+            }
+
+            H_rot.col(j) = H.col(j);
+            for (uint i=0; i<j; ++i)
+            {
+                const UVLM::Types::Real temp = cs(i)*H_rot(i, j) + sn(i)*H_rot(i + 1, j);
+                H_rot(i + 1, j) = -sn(i)*H_rot(i, j) + cs(i)*H_rot(i + 1, j);
+                H_rot(i, j) = temp;
+            }
+            const UVLM::Types::Real denominator = std::sqrt(H_rot(j, j)*H_rot(j, j) +
+                                                            H_rot(j + 1, j)*H_rot(j + 1, j));
+            cs(j) = (denominator == 0.0) ? 1.0 : H_rot(j, j)/denominator;
+            sn(j) = (denominator == 0.0) ? 0.0 : H_rot(j + 1, j)/denominator;
+            H_rot(j, j) = denominator;
+            H_rot(j + 1, j) = 0.0;
+            g(j + 1) = -sn(j)*g(j);
+            g(j) = cs(j)*g(j);
+
+            if ((std::abs(g(j + 1)) <= tolerance*b_norm) || (H(j + 1, j) == 0.0))
+            {
+                ++j;
+                break;
+            }
+        }
+        if (j == 0)
+        {
+            break;
+        }
+
+        // update of the solution and the residual
+        const UVLM::Types::VectorX y =
+            H_rot.topLeftCorner(j, j).triangularView<Eigen::Upper>().solve(g.head(j));
+        UVLM::Types::VectorX dt = V.leftCols(j)*y;
+        if (k > 0)
+        {
+            dt -= U*(B.leftCols(j)*y);
+        }
+        preconditioner(dt, w);
+        x += w;
+        r -= V.leftCols(j + 1)*(H.topLeftCorner(j + 1, j)*y);
+
+        // new recycled space: harmonic Ritz vectors of the smallest
+        // harmonic Ritz values in span([U V])
+        // A*[U V] = [C V+]*G
+        const uint p = k + j;
+        const uint new_k = std::min(n_recycle, p - 1);
+        if (new_k == 0)
+        {
+            continue;
+        }
+        UVLM::Types::MatrixX Y(K, p);
+        UVLM::Types::MatrixX W(K, p + 1);
+        if (k > 0)
+        {
+            Y.leftCols(k) = U;
+            W.leftCols(k) = C;
+        }
+        Y.rightCols(j) = V.leftCols(j);
+        W.rightCols(j + 1) = V.leftCols(j + 1);
+        Eigen::MatrixXd G = Eigen::MatrixXd::Zero(p + 1, p);
+        G.topLeftCorner(k, k).setIdentity();
+        G.block(0, k, k, j) = B.leftCols(j);
+        G.block(k, k, j + 1, j) = H.topLeftCorner(j + 1, j);
+
+        // G^T*G*z = theta*G^T*W^T*Y*z
+        const Eigen::MatrixXd lhs = G.transpose()*G;
+        const Eigen::MatrixXd rhs = G.transpose()*(W.transpose()*Y);
+        const Eigen::FullPivLU<Eigen::MatrixXd> rhs_lu(rhs);
+        if (!rhs_lu.isInvertible())
+        {
+            continue;
+        }
+        const Eigen::EigenSolver<Eigen::MatrixXd> eigen(rhs_lu.solve(lhs));
+        if (eigen.info() != Eigen::Success)
+        {
+            continue;
+        }
+        std::vector<uint> order(p);
+        for (uint i=0; i<p; ++i) {order[i] = i;}
+        std::sort(order.begin(), order.end(),
+                  [&eigen](const uint i1, const uint i2)
+                  {
+                      return std::abs(eigen.eigenvalues()(i1)) < std::abs(eigen.eigenvalues()(i2));
+                  });
+        // real basis of the selected eigenvectors (real and imaginary
+        // parts for complex pairs)
+        Eigen::MatrixXd P(p, new_k);
+        uint n_selected = 0;
+        for (uint i=0; (i<p) && (n_selected<new_k); ++i)
+        {
+            const Eigen::VectorXcd vector = eigen.eigenvectors().col(order[i]);
+            const UVLM::Types::Real imaginary = eigen.eigenvalues()(order[i]).imag();
+            if (imaginary < 0.0)
+            {
+                // already included with its conjugate
+                continue;
+            }
+            P.col(n_selected++) = vector.real();
+            if ((imaginary > 0.0) && (n_selected < new_k))
+            {
+                P.col(n_selected++) = vector.imag();
+            }
+        }
+        U = Y*P.leftCols(n_selected);
+        C = W*(G*P.leftCols(n_selected));
+        UVLM::Krylov::orthonormalise_recycled(C, U);
+    }
+
+    recycle = U;
+    if (r.norm() > tolerance*b_norm)
+    {
+        std::cerr << "GCRO-DR did not converge in "
+                  << max_iterations
+                  << " iterations" << std::endl;
+    }
+    return n_iter;
+}
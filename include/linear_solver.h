@@ -2,12 +2,1046 @@
 
 #include "EigenInclude.h"
 #include "types.h"
+#include "constants.h"
+#include "matrix.h"
+#include "krylov.h"
+#include "tiled_lu.h"
 #include "Eigen/IterativeLinearSolvers"
+#include "Eigen/SparseCore"
+
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <functional>
 
 namespace UVLM
 {
     namespace LinearSolver
     {
+        // Structure of the system of equations: position and size of
+        // the block of every surface and the columns of the trailing
+        // edge panels (the only ones affected by the wake).
+        struct SystemLayout
+        {
+            std::vector<uint> offsets;
+            std::vector<uint> sizes;
+            std::vector<uint> te_columns;
+            // panels (M, N) of every surface
+            UVLM::Types::VecDimensions dimensions;
+        };
+
+        SystemLayout generate_layout
+        (
+            const UVLM::Types::VecDimensions& dimensions
+        )
+        {
+            SystemLayout layout;
+            layout.dimensions = dimensions;
+            // same partition as in the AIC assembly
+            layout.offsets = UVLM::Matrix::surface_offsets(dimensions);
+            for (uint i_surf=0; i_surf<dimensions.size(); ++i_surf)
+            {
+                const uint M = dimensions[i_surf].first;
+                const uint N = dimensions[i_surf].second;
+                layout.sizes.push_back(M*N);
+                for (uint j=0; j<N; ++j)
+                {
+                    layout.te_columns.push_back(layout.offsets[i_surf] + (M - 1)*N + j);
+                }
+            }
+            return layout;
+        }
+
+
+        // Number of previous solutions kept for the initial guess
+        const uint HISTORY_SIZE = 3;
+
+        // State kept between calls to the linear solver.
+        // For the direct solver, the last factorisation: a new system
+        // that only differs from the factorised one in the trailing edge
+        // columns is solved with a low-rank (Sherman-Morrison-Woodbury)
+        // update of the base LU.
+        // For the iterative solver, the last solutions, extrapolated to
+        // get the initial guess.
+        class Session
+        {
+        public:
+            UVLM::Types::SolverStatistics statistics;
+            // deflation space recycled by GCRO-DR between systems
+            UVLM::Types::MatrixX recycle_space;
+
+            void reset()
+            {
+                factorised = false;
+                preconditioner_valid = false;
+                base_aic.resize(0, 0);
+                recycle_space.resize(0, 0);
+                history.clear();
+                statistics = UVLM::Types::SolverStatistics();
+            }
+
+            // Polynomial extrapolation of the last solutions of the
+            // same size, of order up to "order". x is left untouched if
+            // there are none or if order is 0.
+            template <typename t_x>
+            void initial_guess
+            (
+                const uint order,
+                t_x& x
+            ) const
+            {
+                const uint n_history = history.size();
+                if ((order == 0) ||
+                    (n_history == 0) ||
+                    (history.back().size() != x.size()))
+                {
+                    return;
+                }
+                const uint n_points = std::min(order + 1, n_history);
+                if (n_points == 1)
+                {
+                    x = history[n_history - 1];
+                } else if (n_points == 2)
+                {
+                    x = 2.0*history[n_history - 1] - history[n_history - 2];
+                } else
+                {
+                    x = 3.0*history[n_history - 1] -
+                        3.0*history[n_history - 2] +
+                        history[n_history - 3];
+                }
+            }
+
+            template <typename t_x>
+            void record
+            (
+                const t_x& x,
+                const uint iterations,
+                const UVLM::Types::Real guess_residual,
+                const UVLM::Types::Real residual
+            )
+            {
+                if (!history.empty() && (history.back().size() != x.size()))
+                {
+                    history.clear();
+                }
+                history.push_back(x);
+                if (history.size() > HISTORY_SIZE)
+                {
+                    history.erase(history.begin());
+                }
+                ++statistics.n_solves;
+                statistics.last_iterations = iterations;
+                statistics.total_iterations += iterations;
+                statistics.guess_residual = guess_residual;
+                statistics.last_residual = residual;
+            }
+
+            template <typename t_a,
+                      typename t_b,
+                      typename t_x>
+            void solve
+            (
+                const t_a& a,
+                const t_b& b,
+                const SystemLayout& layout,
+                t_x& x
+            )
+            {
+                const uint K = a.rows();
+                if (!factorised || (base_aic.rows() != K))
+                {
+                    factorise(a);
+                    x = base_lu.solve(b);
+                    return;
+                }
+
+                const UVLM::Types::Real tolerance =
+                    UVLM::Constants::EPSILON*base_aic.cwiseAbs().maxCoeff();
+                std::vector<bool> is_te(K, false);
+                for (uint i_col=0; i_col<layout.te_columns.size(); ++i_col)
+                {
+                    is_te[layout.te_columns[i_col]] = true;
+                }
+
+                // columns that changed since the factorisation
+                std::vector<uint> columns;
+                for (uint j=0; j<K; ++j)
+                {
+                    const UVLM::Types::Real change =
+                        (a.col(j) - base_aic.col(j)).cwiseAbs().maxCoeff();
+                    if (change <= tolerance)
+                    {
+                        continue;
+                    }
+                    if (!is_te[j])
+                    {
+                        // the bound lattice changed
+                        factorise(a);
+                        x = base_lu.solve(b);
+                        return;
+                    }
+                    columns.push_back(j);
+                }
+
+                const uint rank = columns.size();
+                if (rank == 0)
+                {
+                    x = base_lu.solve(b);
+                    return;
+                }
+                // the update is not worth it if the rank is high
+                if (rank > K/4)
+                {
+                    factorise(a);
+                    x = base_lu.solve(b);
+                    return;
+                }
+
+                // a = base_aic + U*E^T, E selects the changed columns
+                UVLM::Types::MatrixX U(K, rank);
+                for (uint i_col=0; i_col<rank; ++i_col)
+                {
+                    U.col(i_col) = a.col(columns[i_col]) - base_aic.col(columns[i_col]);
+                }
+                const UVLM::Types::MatrixX Z = base_lu.solve(U);
+                UVLM::Types::MatrixX capacitance = UVLM::Types::MatrixX::Identity(rank, rank);
+                for (uint i_col=0; i_col<rank; ++i_col)
+                {
+                    capacitance.row(i_col) += Z.row(columns[i_col]);
+                }
+
+                const UVLM::Types::VectorX y = base_lu.solve(b);
+                UVLM::Types::VectorX y_columns(rank);
+                for (uint i_col=0; i_col<rank; ++i_col)
+                {
+                    y_columns(i_col) = y(columns[i_col]);
+                }
+                x = y - Z*capacitance.partialPivLu().solve(y_columns);
+                ++statistics.n_updates;
+            }
+
+            // Factorisation of a previous AIC, used as preconditioner.
+            // It is only recomputed if invalidated or if the size of
+            // the system changed.
+            template <typename t_a>
+            const Eigen::PartialPivLU<UVLM::Types::MatrixX>& preconditioner_factorisation
+            (
+                const t_a& a
+            )
+            {
+                if (!preconditioner_valid || (preconditioner_lu.rows() != a.rows()))
+                {
+                    preconditioner_lu.compute(a);
+                    preconditioner_valid = true;
+                    ++statistics.n_factorisations;
+                }
+                return preconditioner_lu;
+            }
+
+            void invalidate_preconditioner()
+            {
+                preconditioner_valid = false;
+            }
+
+        private:
+            bool factorised = false;
+            UVLM::Types::MatrixX base_aic;
+            Eigen::PartialPivLU<UVLM::Types::MatrixX> base_lu;
+            std::vector<UVLM::Types::VectorX> history;
+            bool preconditioner_valid = false;
+            Eigen::PartialPivLU<UVLM::Types::MatrixX> preconditioner_lu;
+
+            template <typename t_a>
+            void factorise
+            (
+                const t_a& a
+            )
+            {
+                base_aic = a;
+                base_lu.compute(base_aic);
+                factorised = true;
+                ++statistics.n_factorisations;
+            }
+        };
+
+        Session& session()
+        {
+            static Session solver_session;
+            return solver_session;
+        }
+
+
+        // Preconditioners for the iterative solver. They follow the
+        // interface of the Eigen preconditioners, so they can be used
+        // as Eigen::BiCGSTAB<MatrixX, Preconditioner>. The layout has to
+        // be given before the solver calls compute().
+        enum PreconditionerType
+        {
+            BLOCK_JACOBI = 0,
+            ILUT = 1,
+            SPAI = 2,
+            STALE_LU = 3,
+            TWO_GRID = 4
+        };
+
+        // Default number of iterations above which the stale LU
+        // preconditioner is refactorised
+        const uint STALE_LU_ITERATIONS = 10;
+
+        // Number of entries (per column) of the near field sparse
+        // approximate inverse
+        const uint SPAI_NEAR_FIELD = 16;
+        // Entries of the AIC smaller than this fraction of the largest
+        // one are dropped before the incomplete factorisation
+        const UVLM::Types::Real ILUT_DROP_TOLERANCE = 1e-3;
+        const int ILUT_FILL_FACTOR = 10;
+
+        // Block-Jacobi: LU factorisation of the block of every surface
+        // with itself
+        class BlockJacobiPreconditioner
+        {
+        public:
+            void set_layout(const SystemLayout& in_layout) {layout = in_layout;}
+
+            template <typename t_mat>
+            BlockJacobiPreconditioner& analyzePattern(const t_mat&) {return *this;}
+
+            template <typename t_mat>
+            BlockJacobiPreconditioner& factorize(const t_mat& a)
+            {
+                if (layout.offsets.empty())
+                {
+                    layout.offsets.push_back(0);
+                    layout.sizes.push_back(a.rows());
+                }
+                const uint n_blocks = layout.offsets.size();
+                lu.resize(n_blocks);
+                #pragma omp parallel for schedule(dynamic)
+                for (uint i_block=0; i_block<n_blocks; ++i_block)
+                {
+                    lu[i_block].compute(a.block(layout.offsets[i_block],
+                                                layout.offsets[i_block],
+                                                layout.sizes[i_block],
+                                                layout.sizes[i_block]));
+                }
+                return *this;
+            }
+
+            template <typename t_mat>
+            BlockJacobiPreconditioner& compute(const t_mat& a) {return factorize(a);}
+
+            template <typename t_rhs>
+            UVLM::Types::VectorX solve(const Eigen::MatrixBase<t_rhs>& b) const
+            {
+                UVLM::Types::VectorX x(b.rows());
+                for (uint i_block=0; i_block<lu.size(); ++i_block)
+                {
+                    x.segment(layout.offsets[i_block], layout.sizes[i_block]) =
+                        lu[i_block].solve(b.segment(layout.offsets[i_block],
+                                                    layout.sizes[i_block]));
+                }
+                return x;
+            }
+
+            Eigen::ComputationInfo info() {return Eigen::Success;}
+
+        private:
+            SystemLayout layout;
+            std::vector<Eigen::PartialPivLU<UVLM::Types::MatrixX> > lu;
+        };
+
+        // Incomplete LU with threshold of the sparsified AIC
+        class ILUTPreconditioner
+        {
+        public:
+            void set_layout(const SystemLayout&) {}
+
+            template <typename t_mat>
+            ILUTPreconditioner& analyzePattern(const t_mat&) {return *this;}
+
+            template <typename t_mat>
+            ILUTPreconditioner& factorize(const t_mat& a)
+            {
+                const Eigen::SparseMatrix<UVLM::Types::Real> sparse_a =
+                    a.sparseView(a.cwiseAbs().maxCoeff(), ILUT_DROP_TOLERANCE);
+                ilut.setDroptol(ILUT_DROP_TOLERANCE);
+                ilut.setFillfactor(ILUT_FILL_FACTOR);
+                ilut.compute(sparse_a);
+                return *this;
+            }
+
+            template <typename t_mat>
+            ILUTPreconditioner& compute(const t_mat& a) {return factorize(a);}
+
+            template <typename t_rhs>
+            UVLM::Types::VectorX solve(const Eigen::MatrixBase<t_rhs>& b) const
+            {
+                return ilut.solve(b);
+            }
+
+            Eigen::ComputationInfo info() {return ilut.info();}
+
+        private:
+            Eigen::IncompleteLUT<UVLM::Types::Real> ilut;
+        };
+
+        // Sparse approximate inverse restricted to the near field:
+        // every column m_j of M ~= A^{-1} minimises ||A m_j - e_j|| with
+        // nonzeros only in the SPAI_NEAR_FIELD panels with the largest
+        // influence on panel j, over the rows of twice as many panels.
+        class SPAIPreconditioner
+        {
+        public:
+            void set_layout(const SystemLayout&) {}
+
+            template <typename t_mat>
+            SPAIPreconditioner& analyzePattern(const t_mat&) {return *this;}
+
+            template <typename t_mat>
+            SPAIPreconditioner& factorize(const t_mat& a)
+            {
+                const uint K = a.rows();
+                const uint n_cols = std::min(SPAI_NEAR_FIELD, K);
+                const uint n_rows = std::min(2*SPAI_NEAR_FIELD, K);
+                std::vector<std::vector<Eigen::Triplet<UVLM::Types::Real> > > triplets(K);
+                #pragma omp parallel for schedule(dynamic)
+                for (uint j=0; j<K; ++j)
+                {
+                    // near field of j: largest entries of its column
+                    std::vector<uint> near(K);
+                    for (uint i=0; i<K; ++i) {near[i] = i;}
+                    std::partial_sort(near.begin(),
+                                      near.begin() + n_rows,
+                                      near.end(),
+                                      [&a, j](const uint i1, const uint i2)
+                                      {
+                                          return std::abs(a(i1, j)) > std::abs(a(i2, j));
+                                      });
+                    // the diagonal always belongs to the pattern
+                    if (std::find(near.begin(), near.begin() + n_cols, j) == near.begin() + n_cols)
+                    {
+                        near[n_cols - 1] = j;
+                    }
+
+                    UVLM::Types::MatrixX local(n_rows, n_cols);
+                    UVLM::Types::VectorX e = UVLM::Types::VectorX::Zero(n_rows);
+                    for (uint i=0; i<n_rows; ++i)
+                    {
+                        for (uint k=0; k<n_cols; ++k)
+                        {
+                            local(i, k) = a(near[i], near[k]);
+                        }
+                        if (near[i] == j) {e(i) = 1.0;}
+                    }
+                    const UVLM::Types::VectorX m = local.colPivHouseholderQr().solve(e);
+                    for (uint k=0; k<n_cols; ++k)
+                    {
+                        triplets[j].push_back(Eigen::Triplet<UVLM::Types::Real>(near[k], j, m(k)));
+                    }
+                }
+                std::vector<Eigen::Triplet<UVLM::Types::Real> > all_triplets;
+                for (uint j=0; j<K; ++j)
+                {
+                    all_triplets.insert(all_triplets.end(), triplets[j].begin(), triplets[j].end());
+                }
+                inverse.resize(K, K);
+                inverse.setFromTriplets(all_triplets.begin(), all_triplets.end());
+                return *this;
+            }
+
+            template <typename t_mat>
+            SPAIPreconditioner& compute(const t_mat& a) {return factorize(a);}
+
+            template <typename t_rhs>
+            UVLM::Types::VectorX solve(const Eigen::MatrixBase<t_rhs>& b) const
+            {
+                return inverse*b;
+            }
+
+            Eigen::ComputationInfo info() {return Eigen::Success;}
+
+        private:
+            Eigen::SparseMatrix<UVLM::Types::Real> inverse;
+        };
+
+
+        // LU factorisation of a previous (slightly different) AIC kept
+        // in the session
+        class StaleLUPreconditioner
+        {
+        public:
+            void set_layout(const SystemLayout&) {}
+
+            template <typename t_mat>
+            StaleLUPreconditioner& analyzePattern(const t_mat&) {return *this;}
+
+            template <typename t_mat>
+            StaleLUPreconditioner& factorize(const t_mat& a)
+            {
+                lu = &session().preconditioner_factorisation(a);
+                return *this;
+            }
+
+            template <typename t_mat>
+            StaleLUPreconditioner& compute(const t_mat& a) {return factorize(a);}
+
+            template <typename t_rhs>
+            UVLM::Types::VectorX solve(const Eigen::MatrixBase<t_rhs>& b) const
+            {
+                return lu->solve(b);
+            }
+
+            Eigen::ComputationInfo info() {return Eigen::Success;}
+
+        private:
+            const Eigen::PartialPivLU<UVLM::Types::MatrixX>* lu = NULL;
+        };
+
+
+        // Coarse level of the lattice: every other vertex is kept (the
+        // last one always is), so every coarse panel merges up to 2x2
+        // panels. The restriction averages the fine panels of every
+        // coarse panel and the prolongation interpolates linearly the
+        // coarse circulation between the centres of the coarse panels.
+        // The coarse system is the Galerkin product R*A*P, so only the
+        // AIC is needed.
+        class CoarseGrid
+        {
+        public:
+            bool setup(const SystemLayout& layout)
+            {
+                const uint n_surf = layout.dimensions.size();
+                if (n_surf == 0) {return false;}
+                std::vector<Eigen::Triplet<UVLM::Types::Real> > restriction_entries;
+                std::vector<Eigen::Triplet<UVLM::Types::Real> > prolongation_entries;
+                uint n_fine = 0;
+                uint n_coarse = 0;
+                for (uint i_surf=0; i_surf<n_surf; ++i_surf)
+                {
+                    const uint M = layout.dimensions[i_surf].first;
+                    const uint N = layout.dimensions[i_surf].second;
+                    const uint M_coarse = (M + 1)/2;
+                    const uint N_coarse = (N + 1)/2;
+                    for (uint i=0; i<M; ++i)
+                    {
+                        std::vector<std::pair<uint, UVLM::Types::Real> > i_weights =
+                            interpolation_weights(i, M_coarse);
+                        for (uint j=0; j<N; ++j)
+                        {
+                            const uint fine = n_fine + i*N + j;
+                            // number of fine panels of the coarse panel
+                            const uint count = ((i/2*2 + 1 < M) ? 2 : 1)*((j/2*2 + 1 < N) ? 2 : 1);
+                            restriction_entries.push_back(
+                                Eigen::Triplet<UVLM::Types::Real>(n_coarse + (i/2)*N_coarse + j/2,
+                                                                  fine,
+                                                                  1.0/count));
+
+                            std::vector<std::pair<uint, UVLM::Types::Real> > j_weights =
+                                interpolation_weights(j, N_coarse);
+                            for (uint ii=0; ii<i_weights.size(); ++ii)
+                            {
+                                for (uint jj=0; jj<j_weights.size(); ++jj)
+                                {
+                                    prolongation_entries.push_back(
+                                        Eigen::Triplet<UVLM::Types::Real>(fine,
+                                                                          n_coarse + i_weights[ii].first*N_coarse + j_weights[jj].first,
+                                                                          i_weights[ii].second*j_weights[jj].second));
+                                }
+                            }
+                        }
+                    }
+                    n_fine += M*N;
+                    n_coarse += M_coarse*N_coarse;
+                }
+                restriction.resize(n_coarse, n_fine);
+                restriction.setFromTriplets(restriction_entries.begin(), restriction_entries.end());
+                prolongation.resize(n_fine, n_coarse);
+                prolongation.setFromTriplets(prolongation_entries.begin(), prolongation_entries.end());
+                return true;
+            }
+
+            template <typename t_mat>
+            void compute(const t_mat& a)
+            {
+                const UVLM::Types::MatrixX ap = a*prolongation;
+                const UVLM::Types::MatrixX coarse = restriction*ap;
+                lu.compute(coarse);
+            }
+
+            // P*A_c^{-1}*R*b
+            template <typename t_rhs>
+            UVLM::Types::VectorX solve(const t_rhs& b) const
+            {
+                const UVLM::Types::VectorX b_coarse = restriction*b;
+                return prolongation*lu.solve(b_coarse);
+            }
+
+        private:
+            Eigen::SparseMatrix<UVLM::Types::Real, Eigen::RowMajor> restriction;
+            Eigen::SparseMatrix<UVLM::Types::Real, Eigen::RowMajor> prolongation;
+            Eigen::PartialPivLU<UVLM::Types::MatrixX> lu;
+
+            // Coarse panels (and weights) of the linear interpolation at
+            // the fine panel i, along a direction with n_coarse panels.
+            // The centre of the fine panel i is at (i - 0.5)/2 in coarse
+            // panel units; beyond the first and last coarse centres the
+            // circulation is extrapolated.
+            static std::vector<std::pair<uint, UVLM::Types::Real> > interpolation_weights
+            (
+                const uint i,
+                const uint n_coarse
+            )
+            {
+                std::vector<std::pair<uint, UVLM::Types::Real> > weights;
+                if (n_coarse == 1)
+                {
+                    weights.push_back(std::make_pair(0u, 1.0));
+                    return weights;
+                }
+                const UVLM::Types::Real position = 0.5*(i - 0.5);
+                const uint first = std::min(static_cast<uint>(std::max(position, 0.0)), n_coarse - 2);
+                const UVLM::Types::Real t = position - first;
+                weights.push_back(std::make_pair(first, 1.0 - t));
+                weights.push_back(std::make_pair(first + 1, t));
+                return weights;
+            }
+        };
+
+        // Two-grid preconditioner: coarse grid correction followed by a
+        // Jacobi smoothing step on the fine lattice.
+        // Without layout (or surface dimensions) it is a Jacobi
+        // preconditioner.
+        class TwoGridPreconditioner
+        {
+        public:
+            void set_layout(const SystemLayout& in_layout) {layout = in_layout;}
+
+            template <typename t_mat>
+            TwoGridPreconditioner& analyzePattern(const t_mat&) {return *this;}
+
+            template <typename t_mat>
+            TwoGridPreconditioner& factorize(const t_mat& a)
+            {
+                with_coarse = coarse.setup(layout) && (a.rows() > 1);
+                if (with_coarse)
+                {
+                    coarse.compute(a);
+                }
+                inverse_diagonal = a.diagonal().cwiseInverse();
+                product = [&a](const UVLM::Types::VectorX& in, UVLM::Types::VectorX& out)
+                {
+                    out.noalias() = a*in;
+                };
+                return *this;
+            }
+
+            template <typename t_mat>
+            TwoGridPreconditioner& compute(const t_mat& a) {return factorize(a);}
+
+            template <typename t_rhs>
+            UVLM::Types::VectorX solve(const Eigen::MatrixBase<t_rhs>& b) const
+            {
+                if (!with_coarse)
+                {
+                    return inverse_diagonal.cwiseProduct(b);
+                }
+                UVLM::Types::VectorX x = coarse.solve(b);
+                UVLM::Types::VectorX ax;
+                product(x, ax);
+                x += inverse_diagonal.cwiseProduct(b - ax);
+                return x;
+            }
+
+            Eigen::ComputationInfo info() {return Eigen::Success;}
+
+        private:
+            SystemLayout layout;
+            CoarseGrid coarse;
+            bool with_coarse = false;
+            UVLM::Types::VectorX inverse_diagonal;
+            std::function<void(const UVLM::Types::VectorX&, UVLM::Types::VectorX&)> product;
+        };
+
+
+        // Replaces the initial guess x of the iterative solver by the
+        // prolongation of the solution on the coarse lattice if it has
+        // a smaller residual
+        template <typename t_a,
+                  typename t_b,
+                  typename t_x>
+        void coarse_initial_guess
+        (
+            const t_a& a,
+            const t_b& b,
+            const SystemLayout& layout,
+            t_x& x
+        )
+        {
+            CoarseGrid coarse;
+            if (!coarse.setup(layout)) {return;}
+            coarse.compute(a);
+            const UVLM::Types::VectorX x_coarse = coarse.solve(b);
+            if ((b - a*x_coarse).squaredNorm() < (b - a*x).squaredNorm())
+            {
+                x = x_coarse;
+            }
+        }
+
+
+        // Mixed precision solver: maximum number of refinement steps and
+        // relative residual to reach
+        const uint MAX_REFINEMENT_STEPS = 10;
+        const UVLM::Types::Real REFINEMENT_TOLERANCE = 1e-12;
+
+        // LU factorisation in single precision of a double precision
+        // system, with iterative refinement of the solution (the residual
+        // is computed with the double precision matrix).
+        // Falls back to a double precision factorisation if the
+        // refinement stalls.
+        template <typename t_a,
+                  typename t_b,
+                  typename t_x>
+        void mixed_precision_solve
+        (
+            const t_a& a,
+            const t_b& b,
+            t_x& x
+        )
+        {
+            const UVLM::Types::MatrixXf a_single = a.template cast<float>();
+            const Eigen::PartialPivLU<UVLM::Types::MatrixXf> lu(a_single);
+            x = lu.solve(b.template cast<float>()).template cast<UVLM::Types::Real>();
+
+            const UVLM::Types::Real b_norm = b.norm();
+            UVLM::Types::Real last_residual = std::numeric_limits<UVLM::Types::Real>::max();
+            for (uint i_step=0; i_step<MAX_REFINEMENT_STEPS; ++i_step)
+            {
+                const UVLM::Types::VectorX r = b - a*x;
+                const UVLM::Types::Real residual = r.norm();
+                if (residual <= REFINEMENT_TOLERANCE*b_norm)
+                {
+                    return;
+                }
+                if (residual > 0.5*last_residual)
+                {
+                    // the refinement is not converging
+                    break;
+                }
+                last_residual = residual;
+                x += lu.solve(r.template cast<float>()).template cast<UVLM::Types::Real>();
+            }
+            ++session().statistics.n_fallbacks;
+            x = a.partialPivLu().solve(b);
+        }
+
+
+        // Block solvers by surfaces
+        enum BlockSolverType
+        {
+            NO_BLOCK_SOLVER = 0,
+            BLOCK_SCHUR = 1,
+            BLOCK_GAUSS_SEIDEL = 2
+        };
+        const uint MAX_GAUSS_SEIDEL_ITERATIONS = 100;
+        const UVLM::Types::Real GAUSS_SEIDEL_TOLERANCE = 1e-10;
+
+        // Block LU factorisation by surfaces: the diagonal block of
+        // every surface is factorised (with partial pivoting) and
+        // eliminated from the rest of the system (Schur complement).
+        // The operations on the blocks of every elimination step are
+        // run as OpenMP tasks.
+        template <typename t_a,
+                  typename t_b,
+                  typename t_x>
+        void block_schur_solve
+        (
+            const t_a& a,
+            const t_b& b,
+            const SystemLayout& layout,
+            t_x& x
+        )
+        {
+            const uint n_blocks = layout.offsets.size();
+            const std::vector<uint>& offset = layout.offsets;
+            const std::vector<uint>& size = layout.sizes;
+            // lower blocks are the updated A_ik, upper blocks
+            // are A_kk^{-1}*A_kj (after the updates)
+            UVLM::Types::MatrixX factors = a;
+            std::vector<Eigen::PartialPivLU<UVLM::Types::MatrixX> > lu(n_blocks);
+
+            #pragma omp parallel
+            {
+                #pragma omp single
+                {
+                    for (uint k=0; k<n_blocks; ++k)
+                    {
+                        lu[k].compute(factors.block(offset[k], offset[k], size[k], size[k]));
+
+                        #pragma omp taskloop
+                        for (uint j=k + 1; j<n_blocks; ++j)
+                        {
+                            factors.block(offset[k], offset[j], size[k], size[j]) =
+                                lu[k].solve(factors.block(offset[k], offset[j], size[k], size[j]));
+                        }
+
+                        // Schur complement of the remaining blocks
+                        #pragma omp taskloop collapse(2)
+                        for (uint i=k + 1; i<n_blocks; ++i)
+                        {
+                            for (uint j=k + 1; j<n_blocks; ++j)
+                            {
+                                factors.block(offset[i], offset[j], size[i], size[j]).noalias() -=
+                                    factors.block(offset[i], offset[k], size[i], size[k])*
+                                    factors.block(offset[k], offset[j], size[k], size[j]);
+                            }
+                        }
+                    }
+                }
+            }
+
+            // forward substitution
+            UVLM::Types::VectorX z = b;
+            for (uint k=0; k<n_blocks; ++k)
+            {
+                for (uint i=0; i<k; ++i)
+                {
+                    z.segment(offset[k], size[k]).noalias() -=
+                        factors.block(offset[k], offset[i], size[k], size[i])*
+                        z.segment(offset[i], size[i]);
+                }
+                z.segment(offset[k], size[k]) = lu[k].solve(z.segment(offset[k], size[k]));
+            }
+            // backward substitution
+            for (int k=n_blocks - 1; k>=0; --k)
+            {
+                for (uint j=k + 1; j<n_blocks; ++j)
+                {
+                    z.segment(offset[k], size[k]).noalias() -=
+                        factors.block(offset[k], offset[j], size[k], size[j])*
+                        z.segment(offset[j], size[j]);
+                }
+            }
+            x = z;
+        }
+
+
+        // Block Gauss-Seidel iterations by surfaces, with the LU of the
+        // diagonal blocks computed in parallel tasks.
+        // Falls back to a full LU if the iterations do not converge.
+        template <typename t_a,
+                  typename t_b,
+                  typename t_x>
+        void block_gauss_seidel_solve
+        (
+            const t_a& a,
+            const t_b& b,
+            const SystemLayout& layout,
+            UVLM::Types::Real tolerance,
+            t_x& x
+        )
+        {
+            const uint n_blocks = layout.offsets.size();
+            const std::vector<uint>& offset = layout.offsets;
+            const std::vector<uint>& size = layout.sizes;
+            if (tolerance <= 0.0)
+            {
+                tolerance = GAUSS_SEIDEL_TOLERANCE;
+            }
+            std::vector<Eigen::PartialPivLU<UVLM::Types::MatrixX> > lu(n_blocks);
+            #pragma omp parallel
+            {
+                #pragma omp single
+                {
+                    for (uint k=0; k<n_blocks; ++k)
+                    {
+                        #pragma omp task firstprivate(k)
+                        lu[k].compute(a.block(offset[k], offset[k], size[k], size[k]));
+                    }
+                }
+            }
+
+            const UVLM::Types::Real b_norm = b.norm();
+            UVLM::Types::VectorX solution = x;
+            if (solution.size() != b.size())
+            {
+                solution.setZero(b.size());
+            }
+            for (uint i_iter=0; i_iter<MAX_GAUSS_SEIDEL_ITERATIONS; ++i_iter)
+            {
+                for (uint k=0; k<n_blocks; ++k)
+                {
+                    UVLM::Types::VectorX rhs = b.segment(offset[k], size[k]);
+                    for (uint j=0; j<n_blocks; ++j)
+                    {
+                        if (j == k) {continue;}
+                        rhs.noalias() -= a.block(offset[k], offset[j], size[k], size[j])*
+                                         solution.segment(offset[j], size[j]);
+                    }
+                    solution.segment(offset[k], size[k]) = lu[k].solve(rhs);
+                }
+                const UVLM::Types::Real residual = (b - a*solution).norm();
+                if (residual <= tolerance*b_norm)
+                {
+                    x = solution;
+                    return;
+                }
+                if (!std::isfinite(residual))
+                {
+                    break;
+                }
+            }
+            // the coupling between surfaces is too strong
+            ++session().statistics.n_fallbacks;
+            x = a.partialPivLu().solve(b);
+        }
+
+
+        template <typename t_preconditioner>
+        void set_preconditioner_layout
+        (
+            t_preconditioner& preconditioner,
+            const SystemLayout& layout
+        )
+        {
+            preconditioner.set_layout(layout);
+        }
+
+        void set_preconditioner_layout
+        (
+            Eigen::DiagonalPreconditioner<UVLM::Types::Real>& preconditioner,
+            const SystemLayout& layout
+        )
+        {
+        }
+
+
+        template <typename t_preconditioner,
+                  typename t_a,
+                  typename t_b,
+                  typename t_x,
+                  typename t_options>
+        Eigen::ComputationInfo iterative_solve
+        (
+            t_a& a,
+            t_b& b,
+            t_options& options,
+            const SystemLayout& layout,
+            t_x& x
+        )
+        {
+            Eigen::BiCGSTAB<UVLM::Types::MatrixX, t_preconditioner> solver;
+            if (options.iterative_tol > 0.0)
+            {
+                solver.setTolerance(options.iterative_tol);
+            }
+            set_preconditioner_layout(solver.preconditioner(), layout);
+            solver.compute(a);
+
+            session().initial_guess(options.gamma_extrapolation, x);
+            if (options.coarse_guess)
+            {
+                coarse_initial_guess(a, b, layout, x);
+            }
+            const UVLM::Types::Real b_norm = b.norm();
+            const UVLM::Types::Real guess_residual =
+                (b_norm > 0.0) ? (b - a*x).norm()/b_norm : 0.0;
+
+            x = solver.solveWithGuess(b, x);
+            session().record(x, solver.iterations(), guess_residual, solver.error());
+            return solver.info();
+        }
+
+
+        // Iterative solution with GCRO-DR, recycling the deflation space
+        // of the previous system kept in the session
+        template <typename t_preconditioner,
+                  typename t_a,
+                  typename t_b,
+                  typename t_x,
+                  typename t_options>
+        void recycled_solve
+        (
+            t_a& a,
+            t_b& b,
+            t_options& options,
+            const SystemLayout& layout,
+            t_x& x
+        )
+        {
+            t_preconditioner preconditioner;
+            set_preconditioner_layout(preconditioner, layout);
+            preconditioner.compute(a);
+
+            session().initial_guess(options.gamma_extrapolation, x);
+            if (options.coarse_guess)
+            {
+                coarse_initial_guess(a, b, layout, x);
+            }
+            const UVLM::Types::VectorX rhs = b;
+            UVLM::Types::VectorX solution = x;
+            const UVLM::Types::Real b_norm = rhs.norm();
+            const UVLM::Types::Real guess_residual =
+                (b_norm > 0.0) ? (rhs - a*solution).norm()/b_norm : 0.0;
+
+            const uint iterations = UVLM::Krylov::gcrodr
+            (
+                [&a](const UVLM::Types::VectorX& in, UVLM::Types::VectorX& out)
+                {
+                    out = a*in;
+                },
+                [&preconditioner](const UVLM::Types::VectorX& in, UVLM::Types::VectorX& out)
+                {
+                    out = preconditioner.solve(in);
+                },
+                rhs,
+                solution,
+                session().recycle_space,
+                (options.iterative_tol > 0.0) ? options.iterative_tol : UVLM::Krylov::DEFAULT_TOLERANCE
+            );
+            x = solution;
+            session().record(x,
+                             iterations,
+                             guess_residual,
+                             (b_norm > 0.0) ? (rhs - a*solution).norm()/b_norm : 0.0);
+        }
+
+
+        // Iterative solution preconditioned with the LU factorisation of
+        // a previous AIC. The factorisation is only updated when the
+        // number of iterations goes above options.stale_lu_iterations.
+        template <typename t_a,
+                  typename t_b,
+                  typename t_x,
+                  typename t_options>
+        void stale_lu_solve
+        (
+            t_a& a,
+            t_b& b,
+            t_options& options,
+            const SystemLayout& layout,
+            t_x& x
+        )
+        {
+            const uint max_iterations = (options.stale_lu_iterations > 0) ?
+                                        options.stale_lu_iterations :
+                                        STALE_LU_ITERATIONS;
+            const t_x x0 = x;
+            if (iterative_solve<StaleLUPreconditioner>(a, b, options, layout, x) != Eigen::Success)
+            {
+                // the preconditioner is too far from the current AIC
+                session().invalidate_preconditioner();
+                x = x0;
+                iterative_solve<StaleLUPreconditioner>(a, b, options, layout, x);
+            } else if (session().statistics.last_iterations > max_iterations)
+            {
+                // refactorise for the next solution
+                session().invalidate_preconditioner();
+            }
+        }
+
+
         template <typename t_a,
                   typename t_b,
                   typename t_x,
@@ -17,15 +1051,130 @@ namespace UVLM
             t_a& a,
             t_b& b,
             t_options& options,
+            const SystemLayout& layout,
             t_x& x
         )
         {
             if (options.iterative_solver)
             {
                 // we use iterative solver
-                    Eigen::BiCGSTAB<t_a> solver;
-                    solver.compute(a);
-                    x = solver.solveWithGuess(b, x);
+                if (options.krylov_recycling)
+                {
+                    if (!options.iterative_precond)
+                    {
+                        recycled_solve<Eigen::DiagonalPreconditioner<UVLM::Types::Real> >(a, b, options, layout, x);
+                    } else if (options.iterative_precond_type == ILUT)
+                    {
+                        recycled_solve<ILUTPreconditioner>(a, b, options, layout, x);
+                    } else if (options.iterative_precond_type == SPAI)
+                    {
+                        recycled_solve<SPAIPreconditioner>(a, b, options, layout, x);
+                    } else if (options.iterative_precond_type == STALE_LU)
+                    {
+                        recycled_solve<StaleLUPreconditioner>(a, b, options, layout, x);
+                    } else if (options.iterative_precond_type == TWO_GRID)
+                    {
+                        recycled_solve<TwoGridPreconditioner>(a, b, options, layout, x);
+                    } else
+                    {
+                        recycled_solve<BlockJacobiPreconditioner>(a, b, options, layout, x);
+                    }
+                } else if (!options.iterative_precond)
+                {
+                    iterative_solve<Eigen::DiagonalPreconditioner<UVLM::Types::Real> >(a, b, options, layout, x);
+                } else if (options.iterative_precond_type == ILUT)
+                {
+                    iterative_solve<ILUTPreconditioner>(a, b, options, layout, x);
+                } else if (options.iterative_precond_type == SPAI)
+                {
+                    iterative_solve<SPAIPreconditioner>(a, b, options, layout, x);
+                } else if (options.iterative_precond_type == STALE_LU)
+                {
+                    stale_lu_solve(a, b, options, layout, x);
+                } else if (options.iterative_precond_type == TWO_GRID)
+                {
+                    iterative_solve<TwoGridPreconditioner>(a, b, options, layout, x);
+                } else
+                {
+                    iterative_solve<BlockJacobiPreconditioner>(a, b, options, layout, x);
+                }
+            } else if (options.lowrank_update)
+            {
+                session().solve(a, b, layout, x);
+            } else if (options.mixed_precision)
+            {
+                mixed_precision_solve(a, b, x);
+            } else if ((options.block_solver == BLOCK_SCHUR) &&
+                       (layout.offsets.size() > 1))
+            {
+                block_schur_solve(a, b, layout, x);
+            } else if ((options.block_solver == BLOCK_GAUSS_SEIDEL) &&
+                       (layout.offsets.size() > 1))
+            {
+                block_gauss_seidel_solve(a, b, layout, options.iterative_tol, x);
+            } else if (options.tiled_lu)
+            {
+                UVLM::TiledLU::Factorisation lu;
+                lu.compute(a);
+                x = lu.solve(b);
+            } else
+            {
+                x = a.partialPivLu().solve(b);
+            }
+        }
+
+
+        template <typename t_a,
+                  typename t_b,
+                  typename t_x,
+                  typename t_options>
+        void solve_system
+        (
+            t_a& a,
+            t_b& b,
+            t_options& options,
+            t_x& x
+        )
+        {
+            solve_system(a, b, options, SystemLayout(), x);
+        }
+
+
+        // Solution of the same system for several right-hand sides (the
+        // columns of b). The direct solvers factorise a once and solve all
+        // the columns together with matrix triangular solves; the rest of
+        // the solvers go through solve_system column by column.
+        template <typename t_a,
+                  typename t_b,
+                  typename t_x,
+                  typename t_options>
+        void solve_multiple_systems
+        (
+            t_a& a,
+            t_b& b,
+            t_options& options,
+            const SystemLayout& layout,
+            t_x& x
+        )
+        {
+            if (options.iterative_solver ||
+                options.lowrank_update ||
+                options.mixed_precision ||
+                ((options.block_solver != NO_BLOCK_SOLVER) && (layout.offsets.size() > 1)))
+            {
+                for (uint i_col=0; i_col<b.cols(); ++i_col)
+                {
+                    UVLM::Types::VectorX b_col = b.col(i_col);
+                    UVLM::Types::VectorX x_col = x.col(i_col);
+                    solve_system(a, b_col, options, layout, x_col);
+                    x.col(i_col) = x_col;
+                }
+            } else if (options.tiled_lu)
+            {
+                UVLM::TiledLU::Factorisation lu;
+                lu.compute(a);
+                x = b;
+                lu.solve_in_place(x);
             } else
             {
                 x = a.partialPivLu().solve(b);
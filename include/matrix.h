@@ -2,9 +2,13 @@
 
 #include "EigenInclude.h"
 #include "types.h"
+#include "constants.h"
+#include "geometry.h"
 #include "biotsavart.h"
+#include "hmatrix.h"
 
 #include <fstream>
+#include <algorithm>
 
 namespace UVLM
 {
@@ -62,6 +66,199 @@ namespace UVLM
         );
 
 
+        std::vector<uint> surface_offsets
+        (
+            const UVLM::Types::VecDimensions& dimensions
+        );
+
+
+        template <typename t_zeta,
+                  typename t_zeta_star,
+                  typename t_ttriad,
+                  typename t_normal,
+                  typename t_bound_row,
+                  typename t_wake_row>
+        void AIC_row
+        (
+            const t_zeta& zeta,
+            const t_zeta_star& zeta_star,
+            const t_ttriad& target_triad,
+            const t_normal& normal,
+            const UVLM::Types::VMopts& options,
+            const bool horseshoe,
+            const bool compute_bound,
+            const bool compute_wake,
+            t_bound_row bound_row,
+            t_wake_row wake_row
+        );
+
+        // AIC_row with the number of mirror images and the horseshoe flag
+        // fixed at compile time (see BiotSavart::with_images)
+        template <uint n_images,
+                  bool horseshoe,
+                  typename t_zeta,
+                  typename t_zeta_star,
+                  typename t_ttriad,
+                  typename t_normal,
+                  typename t_bound_row,
+                  typename t_wake_row>
+        void AIC_row_kernel
+        (
+            const t_zeta& zeta,
+            const t_zeta_star& zeta_star,
+            const t_ttriad& target_triad,
+            const t_normal& normal,
+            const UVLM::Types::MirrorImages& images,
+            const bool compute_bound,
+            const bool compute_wake,
+            t_bound_row bound_row,
+            t_wake_row wake_row
+        );
+
+
+        // A lattice (or a part of it) tracked by the AIC cache.
+        // reference is a 3xn copy of its points at the time they were
+        // registered, and rotation and translation the rigid motion
+        // from the reference to the current position.
+        // version is increased every time the lattice deforms.
+        struct CacheBody
+        {
+            UVLM::Types::MatrixX reference;
+            UVLM::Types::Matrix3 rotation;
+            UVLM::Types::Vector3 translation;
+            UVLM::Types::Real scale = 0.0;
+            uint version = 0;
+        };
+
+        // Cached AIC block for a pair (target, source), with the
+        // relative pose of both bodies when it was computed.
+        struct CacheBlock
+        {
+            bool valid = false;
+            uint target_version = 0;
+            uint source_version = 0;
+            UVLM::Types::Matrix3 rotation;
+            UVLM::Types::Vector3 translation;
+            UVLM::Types::MatrixX block;
+        };
+
+        // Cache of AIC blocks keyed on the relative pose of every pair of
+        // surfaces. The bound and wake contributions are stored
+        // separately, so a wake moving with respect to the wing only
+        // invalidates the trailing edge columns of its blocks.
+        class AICCache
+        {
+        public:
+            std::vector<CacheBody> surfaces;
+            std::vector<CacheBody> wakes;
+            // indexed by icol_surf*n_surf + ii_surf
+            std::vector<CacheBlock> bound_blocks;
+            std::vector<CacheBlock> wake_blocks;
+
+            void setup
+            (
+                const UVLM::Types::VecDimensions& dimensions,
+                const UVLM::Types::VecDimensions& dimensions_star,
+                const UVLM::Types::VMopts& options,
+                const bool horseshoe
+            );
+
+            void update_body
+            (
+                CacheBody& body,
+                const UVLM::Types::MatrixX& points
+            );
+
+            bool is_valid
+            (
+                const CacheBlock& block,
+                const CacheBody& target,
+                const CacheBody& source
+            ) const;
+
+            void store
+            (
+                CacheBlock& block,
+                const CacheBody& target,
+                const CacheBody& source
+            );
+
+            void clear();
+
+        private:
+            UVLM::Types::VecDimensions dimensions;
+            UVLM::Types::VecDimensions dimensions_star;
+            bool steady = false;
+            bool horseshoe = false;
+            bool image_method = false;
+
+            void relative_pose
+            (
+                const CacheBody& target,
+                const CacheBody& source,
+                UVLM::Types::Matrix3& rotation,
+                UVLM::Types::Vector3& translation
+            ) const;
+        };
+
+        AICCache& aic_cache();
+
+
+        template <typename t_mat>
+        UVLM::Types::MatrixX lattice_points
+        (
+            const t_mat& zeta,
+            const uint n_rows
+        );
+
+
+        // Entries of the AIC evaluated on demand, for the assembly of
+        // the compressed (H-matrix) AIC.
+        // Entry (i, j) is the normal velocity at the collocation point i
+        // induced by the vortex ring j (plus its wake column, if it is a
+        // trailing edge panel of a steady AIC) with unit circulation.
+        template <typename t_zeta,
+                  typename t_zeta_col,
+                  typename t_zeta_star,
+                  typename t_normals>
+        class AICEntries
+        {
+        public:
+            AICEntries
+            (
+                const t_zeta& zeta,
+                const t_zeta_col& zeta_col,
+                const t_zeta_star& zeta_star,
+                const t_normals& normals,
+                const UVLM::Types::VMopts& options,
+                const bool horseshoe
+            );
+
+            UVLM::Types::Real operator()
+            (
+                const uint row,
+                const uint col
+            ) const;
+
+            uint size() const {return surface_index.size();}
+            UVLM::Types::MatrixX points() const;
+            std::vector<UVLM::HMatrix::BoundingBox> source_boxes() const;
+
+        private:
+            const t_zeta& zeta;
+            const t_zeta_col& zeta_col;
+            const t_zeta_star& zeta_star;
+            const t_normals& normals;
+            const bool with_wake;
+            const bool horseshoe;
+            const UVLM::Types::MirrorImages images;
+            // surface and panel indices of every unknown
+            std::vector<uint> surface_index;
+            std::vector<uint> i_index;
+            std::vector<uint> j_index;
+        };
+
+
         template <typename t_gamma,
                   typename t_zeta_col>
         void reconstruct_gamma
@@ -80,6 +277,19 @@ namespace UVLM
             UVLM::Types::VectorX& gamma_flat,
             const t_zeta_col& zeta_col
         );
+
+
+        template <typename t_zeta_col,
+                  typename t_zeta_star,
+                  typename t_normals>
+        void wake_normal_wash
+        (
+            const t_zeta_col& zeta_col,
+            const t_zeta_star& zeta_star,
+            const t_normals& normals,
+            UVLM::Types::MatrixX& wash,
+            const UVLM::Types::MirrorImages& images = UVLM::Types::MirrorImages()
+        );
     }
 }
 // SOURCE CODE
@@ -116,68 +326,342 @@ void UVLM::Matrix::AIC
 
     // build the offsets beforehand
     // (parallel variation)
-    std::vector<uint> offset;
-    uint i_offset = 0;
-    for (uint icol_surf=0; icol_surf<n_surf; ++icol_surf)
+    const std::vector<uint> offset = UVLM::Matrix::surface_offsets(dimensions);
+
+    // The unsteady AIC only includes the bound lattice: the first row of
+    // the wake is treated explicitly in the RHS.
+    const bool with_wake = options.Steady;
+
+    // pairs (icol_surf, ii_surf) whose bound and/or wake blocks need
+    // to be computed
+    std::vector<UVLM::Types::IntPair> pairs;
+    std::vector<bool> pair_bound;
+    std::vector<bool> pair_wake;
+
+    UVLM::Matrix::AICCache* cache = NULL;
+    // with mirror images the blocks also depend on the pose of the bodies
+    // relative to the mirror planes, not only on their relative pose
+    if (options.aic_cache && UVLM::Types::mirror_images(options).empty())
     {
-        offset.push_back(i_offset);
-        uint k_surf = dimensions[icol_surf].first*
-                      dimensions[icol_surf].second;
-        i_offset += k_surf;
+        cache = &UVLM::Matrix::aic_cache();
+        cache->setup(dimensions, dimensions_star, options, horseshoe);
+        for (uint i_surf=0; i_surf<n_surf; ++i_surf)
+        {
+            cache->update_body(cache->surfaces[i_surf],
+                               UVLM::Matrix::lattice_points(zeta[i_surf],
+                                                            dimensions[i_surf].first + 1));
+            if (with_wake)
+            {
+                // the horseshoe only uses the first two rows of zeta_star
+                const uint n_rows = horseshoe ? 2 : dimensions_star[i_surf].first + 1;
+                cache->update_body(cache->wakes[i_surf],
+                                   UVLM::Matrix::lattice_points(zeta_star[i_surf],
+                                                                n_rows));
+            }
+        }
     }
 
-    // fill up AIC
     for (uint icol_surf=0; icol_surf<n_surf; ++icol_surf)
     {
-        uint k_surf = dimensions[icol_surf].first*
-                      dimensions[icol_surf].second;
+        for (uint ii_surf=0; ii_surf<n_surf; ++ii_surf)
+        {
+            bool compute_bound = true;
+            bool compute_wake = with_wake;
+            if (cache)
+            {
+                const uint i_block = icol_surf*n_surf + ii_surf;
+                compute_bound = !cache->is_valid(cache->bound_blocks[i_block],
+                                                 cache->surfaces[icol_surf],
+                                                 cache->surfaces[ii_surf]);
+                compute_wake = with_wake &&
+                               !cache->is_valid(cache->wake_blocks[i_block],
+                                                cache->surfaces[icol_surf],
+                                                cache->wakes[ii_surf]);
+                if (compute_bound)
+                {
+                    cache->bound_blocks[i_block].block.setZero(
+                        dimensions[icol_surf].first*dimensions[icol_surf].second,
+                        dimensions[ii_surf].first*dimensions[ii_surf].second);
+                }
+                if (compute_wake)
+                {
+                    cache->wake_blocks[i_block].block.setZero(
+                        dimensions[icol_surf].first*dimensions[icol_surf].second,
+                        dimensions[ii_surf].second);
+                } else if (!with_wake)
+                {
+                    cache->wake_blocks[i_block].block.setZero(
+                        dimensions[icol_surf].first*dimensions[icol_surf].second,
+                        0);
+                }
+            }
+            if (compute_bound || compute_wake)
+            {
+                pairs.push_back(UVLM::Types::IntPair(icol_surf, ii_surf));
+                pair_bound.push_back(compute_bound);
+                pair_wake.push_back(compute_wake);
+            }
+        }
+    }
+
+    // fill up AIC (or the cache)
+    // Every pair is an independent set of tasks, each one in charge of
+    // a chunk of collocation points, instead of a parallel loop nested
+    // in the loop over pairs.
+    const uint n_pairs = pairs.size();
+    // the kernel variant for the mirror images and the horseshoe flag is
+    // selected once for the whole matrix
+    const UVLM::Types::MirrorImages images = UVLM::Types::mirror_images(options);
+    UVLM::BiotSavart::with_images(images.n_images, [&](auto n_images)
+    {
+        UVLM::BiotSavart::with_flag(horseshoe, [&](auto is_horseshoe)
+        {
+            #pragma omp parallel
+            {
+                #pragma omp single
+                {
+                    for (uint i_pair=0; i_pair<n_pairs; ++i_pair)
+                    {
+                        const uint icol_surf = pairs[i_pair].first;
+                        const uint ii_surf = pairs[i_pair].second;
+                        const uint i_block = icol_surf*n_surf + ii_surf;
+                        const bool compute_bound = pair_bound[i_pair];
+                        const bool compute_wake = pair_wake[i_pair];
+
+                        const uint col_M = dimensions[icol_surf].first;
+                        const uint col_N = dimensions[icol_surf].second;
+                        const uint k_surf = col_M*col_N;
+                        const uint kk_surf = dimensions[ii_surf].first*
+                                             dimensions[ii_surf].second;
+                        // trailing edge panels of the source surface
+                        const uint te_offset = (dimensions[ii_surf].first - 1)*
+                                               dimensions[ii_surf].second;
+                        const uint n_te = dimensions[ii_surf].second;
+                        // roughly the same number of induced velocity evaluations per task
+                        const uint grain = std::max(1u, 2048u/std::max(1u, kk_surf));
 
-        // uint ii_offset = 0;
+                        #pragma omp taskloop nogroup grainsize(grain) firstprivate(icol_surf, ii_surf, i_block, compute_bound, compute_wake, col_N, kk_surf, te_offset, n_te)
+                        for (uint i_col=0; i_col<k_surf; ++i_col)
+                        {
+                            UVLM::Types::Vector3 target_triad;
+                            UVLM::Types::Vector3 normal;
+                            target_triad << zeta_col[icol_surf][0](i_col/col_N, i_col%col_N),
+                                            zeta_col[icol_surf][1](i_col/col_N, i_col%col_N),
+                                            zeta_col[icol_surf][2](i_col/col_N, i_col%col_N);
+                            normal << normals[icol_surf][0](i_col/col_N, i_col%col_N),
+                                      normals[icol_surf][1](i_col/col_N, i_col%col_N),
+                                      normals[icol_surf][2](i_col/col_N, i_col%col_N);
+                            UVLM::ISA::dispatch([&]()
+                            {
+                                if (cache)
+                                {
+                                    UVLM::Matrix::AIC_row_kernel<decltype(n_images)::value,
+                                                                 decltype(is_horseshoe)::value>
+                                    (
+                                        zeta[ii_surf],
+                                        zeta_star[ii_surf],
+                                        target_triad,
+                                        normal,
+                                        images,
+                                        compute_bound,
+                                        compute_wake,
+                                        cache->bound_blocks[i_block].block.row(i_col),
+                                        cache->wake_blocks[i_block].block.row(i_col)
+                                    );
+                                } else
+                                {
+                                    const uint row = offset[icol_surf] + i_col;
+                                    UVLM::Matrix::AIC_row_kernel<decltype(n_images)::value,
+                                                                 decltype(is_horseshoe)::value>
+                                    (
+                                        zeta[ii_surf],
+                                        zeta_star[ii_surf],
+                                        target_triad,
+                                        normal,
+                                        images,
+                                        compute_bound,
+                                        compute_wake,
+                                        aic.block(row, offset[ii_surf], 1, kk_surf),
+                                        aic.block(row, offset[ii_surf] + te_offset, 1, n_te)
+                                    );
+                                }
+                            });
+                        }
+                    }
+                }
+            }
+        });
+    });
+
+    if (!cache)
+    {
+        return;
+    }
+
+    // AIC from the cached blocks
+    for (uint i_pair=0; i_pair<n_pairs; ++i_pair)
+    {
+        const uint i_block = pairs[i_pair].first*n_surf + pairs[i_pair].second;
+        if (pair_bound[i_pair])
+        {
+            cache->store(cache->bound_blocks[i_block],
+                         cache->surfaces[pairs[i_pair].first],
+                         cache->surfaces[pairs[i_pair].second]);
+        }
+        if (pair_wake[i_pair])
+        {
+            cache->store(cache->wake_blocks[i_block],
+                         cache->surfaces[pairs[i_pair].first],
+                         cache->wakes[pairs[i_pair].second]);
+        }
+    }
+    for (uint icol_surf=0; icol_surf<n_surf; ++icol_surf)
+    {
+        const uint k_surf = dimensions[icol_surf].first*
+                            dimensions[icol_surf].second;
         for (uint ii_surf=0; ii_surf<n_surf; ++ii_surf)
         {
-            uint kk_surf = dimensions[ii_surf].first*
-                           dimensions[ii_surf].second;
-            UVLM::Types::MatrixX dummy_gamma;
-            UVLM::Types::MatrixX dummy_gamma_star;
-            UVLM::Types::Block block = aic.block(offset[icol_surf], offset[ii_surf], k_surf, kk_surf);
-            // steady wake coefficients
-            dummy_gamma.setOnes(dimensions[ii_surf].first,
-                                dimensions[ii_surf].second);
-            if (options.Steady)
+            const uint i_block = icol_surf*n_surf + ii_surf;
+            const uint kk_surf = dimensions[ii_surf].first*
+                                 dimensions[ii_surf].second;
+            aic.block(offset[icol_surf], offset[ii_surf], k_surf, kk_surf) =
+                cache->bound_blocks[i_block].block;
+            if (with_wake)
+            {
+                const uint te_offset = (dimensions[ii_surf].first - 1)*
+                                       dimensions[ii_surf].second;
+                aic.block(offset[icol_surf],
+                          offset[ii_surf] + te_offset,
+                          k_surf,
+                          dimensions[ii_surf].second) +=
+                    cache->wake_blocks[i_block].block;
+            }
+        }
+    }
+}
+
+
+/*-----------------------------------------------------------------------------
+Normal induced velocity of every panel of a surface (bound_row) and of every
+wake column (wake_row, trailing edge panels) on a single collocation point.
+Both rows are overwritten (if their compute flag is set).
+-----------------------------------------------------------------------------*/
+template <typename t_zeta,
+          typename t_zeta_star,
+          typename t_ttriad,
+          typename t_normal,
+          typename t_bound_row,
+          typename t_wake_row>
+void UVLM::Matrix::AIC_row
+(
+    const t_zeta& zeta,
+    const t_zeta_star& zeta_star,
+    const t_ttriad& target_triad,
+    const t_normal& normal,
+    const UVLM::Types::VMopts& options,
+    const bool horseshoe,
+    const bool compute_bound,
+    const bool compute_wake,
+    t_bound_row bound_row,
+    t_wake_row wake_row
+)
+{
+    const UVLM::Types::MirrorImages images = UVLM::Types::mirror_images(options);
+    UVLM::BiotSavart::with_images(images.n_images, [&](auto n_images)
+    {
+        UVLM::BiotSavart::with_flag(horseshoe, [&](auto is_horseshoe)
+        {
+            UVLM::ISA::dispatch([&]()
             {
-                dummy_gamma_star.setOnes(dimensions_star[ii_surf].first,
-                                         dimensions_star[ii_surf].second);
-                UVLM::BiotSavart::multisurface_steady_wake
-                (
-                    zeta[ii_surf],
-                    zeta_star[ii_surf],
-                    dummy_gamma,
-                    dummy_gamma_star,
-                    zeta_col[icol_surf],
-                    horseshoe,
-                    block,
-                    options.ImageMethod,
-                    normals[icol_surf]
-                );
-            } else // unsteady case
+                UVLM::Matrix::AIC_row_kernel<decltype(n_images)::value,
+                                             decltype(is_horseshoe)::value>(zeta,
+                                                                            zeta_star,
+                                                                            target_triad,
+                                                                            normal,
+                                                                            images,
+                                                                            compute_bound,
+                                                                            compute_wake,
+                                                                            bound_row,
+                                                                            wake_row);
+            });
+        });
+    });
+}
+
+
+template <uint n_images,
+          bool horseshoe,
+          typename t_zeta,
+          typename t_zeta_star,
+          typename t_ttriad,
+          typename t_normal,
+          typename t_bound_row,
+          typename t_wake_row>
+void UVLM::Matrix::AIC_row_kernel
+(
+    const t_zeta& zeta,
+    const t_zeta_star& zeta_star,
+    const t_ttriad& target_triad,
+    const t_normal& normal,
+    const UVLM::Types::MirrorImages& images,
+    const bool compute_bound,
+    const bool compute_wake,
+    t_bound_row bound_row,
+    t_wake_row wake_row
+)
+{
+    const uint M = zeta[0].rows() - 1;
+    const uint N = zeta[0].cols() - 1;
+
+    if (compute_bound)
+    {
+        UVLM::Types::MatrixX dummy_gamma;
+        dummy_gamma.setOnes(M, N);
+        UVLM::Types::VecMatrixX temp_uout;
+        UVLM::Types::allocate_VecMat(temp_uout, zeta, -1);
+        UVLM::BiotSavart::surface_kernel<n_images>(zeta,
+                                                   dummy_gamma,
+                                                   target_triad,
+                                                   temp_uout,
+                                                   0,
+                                                   0,
+                                                   M,
+                                                   N,
+                                                   images);
+        for (uint i=0; i<M; ++i)
+        {
+            for (uint j=0; j<N; ++j)
             {
-                dummy_gamma_star.setOnes(1,
-                                         dimensions_star[ii_surf].second);
-                UVLM::BiotSavart::multisurface_unsteady_wake
-                (
-                    zeta[ii_surf],
-                    zeta_star[ii_surf],
-                    dummy_gamma,
-                    dummy_gamma_star,
-                    zeta_col[icol_surf],
-                    block,
-                    options.ImageMethod,
-                    normals[icol_surf],
-                    0
-                );
+                bound_row(0, i*N + j) = temp_uout[0](i, j)*normal(0) +
+                                     temp_uout[1](i, j)*normal(1) +
+                                     temp_uout[2](i, j)*normal(2);
             }
         }
     }
+
+    if (compute_wake)
+    {
+        // steady wake coefficients
+        UVLM::Types::MatrixX dummy_gamma_star;
+        dummy_gamma_star.setOnes(zeta_star[0].rows() - 1, N);
+        UVLM::Types::VecMatrixX temp_uout(UVLM::Constants::NDIM);
+        for (uint i_dim=0; i_dim<UVLM::Constants::NDIM; ++i_dim)
+        {
+            temp_uout[i_dim].setZero(1, N);
+        }
+        UVLM::BiotSavart::steady_wake_kernel<n_images, horseshoe>(zeta_star,
+                                                                  dummy_gamma_star,
+                                                                  target_triad,
+                                                                  temp_uout,
+                                                                  0,
+                                                                  images);
+        for (uint j=0; j<N; ++j)
+        {
+            wake_row(0, j) += temp_uout[0](0, j)*normal(0) +
+                           temp_uout[1](0, j)*normal(1) +
+                           temp_uout[2](0, j)*normal(2);
+        }
+    }
 }
 
 /*-----------------------------------------------------------------------------
@@ -201,9 +685,21 @@ void UVLM::Matrix::RHS
 )
 {
     const uint n_surf = options.NumSurfaces;
+    const UVLM::Types::MirrorImages images = UVLM::Types::mirror_images(options);
 
     rhs.setZero(Ktotal);
 
+    // wake segments, shared by all the collocation points
+    UVLM::BiotSavart::SegmentTable wake_segments;
+    if (!options.Steady)
+    {
+        for (uint i_surf=0; i_surf<n_surf; ++i_surf)
+        {
+            wake_segments.add_surface(zeta_star[i_surf], gamma_star[i_surf]);
+        }
+        if (options.morton_order) {wake_segments.sort_morton();}
+    }
+
     // filling up RHS
     int ii = -1;
     int istart = 0;
@@ -214,36 +710,21 @@ void UVLM::Matrix::RHS
 
         if (!options.Steady)
         {
+            // we have to add the wake effect on the induced velocity.
+            UVLM::Types::VecMatrixX v_ind;
+            UVLM::Types::allocate_VecMat(v_ind, uinc_col[i_surf]);
+            wake_segments.induced_velocities_on_surface(zeta_col[i_surf], v_ind, images);
+
             #pragma omp parallel for collapse(2)
             for (uint i=0; i<M; ++i)
             {
                 for (uint j=0; j<N; ++j)
                 {
-                    UVLM::Types::Vector3 v_ind;
-                    UVLM::Types::Vector3 collocation_coords;
                     UVLM::Types::Vector3 u_col;
 
-                    u_col << uinc_col[i_surf][0](i,j),
-                             uinc_col[i_surf][1](i,j),
-                             uinc_col[i_surf][2](i,j);
-                    // we have to add the wake effect on the induced velocity.
-                    collocation_coords << zeta_col[i_surf][0](i,j),
-                                          zeta_col[i_surf][1](i,j),
-                                          zeta_col[i_surf][2](i,j);
-
-                    v_ind.setZero();
-                    for (uint ii_surf=0; ii_surf<n_surf; ++ii_surf)
-                    {
-                        v_ind += UVLM::BiotSavart::whole_surface(zeta_star[ii_surf],
-                                                                      gamma_star[ii_surf],
-                                                                      collocation_coords,
-                                                                      0,
-                                                                      0,
-                                                                      -1,
-                                                                      -1,
-                                                                      options.ImageMethod);
-                    }
-                    u_col += v_ind;
+                    u_col << uinc_col[i_surf][0](i,j) + v_ind[0](i,j),
+                             uinc_col[i_surf][1](i,j) + v_ind[1](i,j),
+                             uinc_col[i_surf][2](i,j) + v_ind[2](i,j);
 
                     // dot product of uinc and panel normal
                     uint counter = istart + j + i*N;
@@ -302,6 +783,342 @@ void UVLM::Matrix::generate_assembly_offset
     }
 }
 
+// Position of the first panel of every surface in the flattened
+// system of equations
+std::vector<uint> UVLM::Matrix::surface_offsets
+(
+    const UVLM::Types::VecDimensions& dimensions
+)
+{
+    const uint n_surf = dimensions.size();
+    std::vector<uint> offset;
+    uint i_offset = 0;
+    for (uint i_surf=0; i_surf<n_surf; ++i_surf)
+    {
+        offset.push_back(i_offset);
+        i_offset += dimensions[i_surf].first*
+                    dimensions[i_surf].second;
+    }
+    return offset;
+}
+
+
+/*-----------------------------------------------------------------------------
+AIC cache
+-----------------------------------------------------------------------------*/
+UVLM::Matrix::AICCache& UVLM::Matrix::aic_cache()
+{
+    static UVLM::Matrix::AICCache cache;
+    return cache;
+}
+
+
+void UVLM::Matrix::AICCache::clear()
+{
+    surfaces.clear();
+    wakes.clear();
+    bound_blocks.clear();
+    wake_blocks.clear();
+    dimensions.clear();
+    dimensions_star.clear();
+}
+
+
+// Discards everything if the lattice sizes or the type of AIC changed
+// since the last call.
+void UVLM::Matrix::AICCache::setup
+(
+    const UVLM::Types::VecDimensions& in_dimensions,
+    const UVLM::Types::VecDimensions& in_dimensions_star,
+    const UVLM::Types::VMopts& options,
+    const bool in_horseshoe
+)
+{
+    if ((in_dimensions == dimensions) &&
+        (in_dimensions_star == dimensions_star) &&
+        (options.Steady == steady) &&
+        (in_horseshoe == horseshoe) &&
+        (options.ImageMethod == image_method))
+    {
+        return;
+    }
+    clear();
+    dimensions = in_dimensions;
+    dimensions_star = in_dimensions_star;
+    steady = options.Steady;
+    horseshoe = in_horseshoe;
+    image_method = options.ImageMethod;
+
+    const uint n_surf = dimensions.size();
+    surfaces.resize(n_surf);
+    wakes.resize(n_surf);
+    bound_blocks.resize(n_surf*n_surf);
+    wake_blocks.resize(n_surf*n_surf);
+}
+
+
+// Finds the rigid motion of the body from its reference shape.
+// If the points do not follow a rigid motion, they become the new
+// reference and every block depending on the body is invalidated.
+void UVLM::Matrix::AICCache::update_body
+(
+    CacheBody& body,
+    const UVLM::Types::MatrixX& points
+)
+{
+    if (body.reference.cols() == points.cols())
+    {
+        const UVLM::Types::Real residual =
+            UVLM::Geometry::rigid_transform(body.reference,
+                                            points,
+                                            body.rotation,
+                                            body.translation);
+        if (residual <= UVLM::Constants::POSE_TOLERANCE*body.scale)
+        {
+            return;
+        }
+    }
+    body.reference = points;
+    body.rotation.setIdentity();
+    body.translation.setZero();
+    body.scale = (points.rowwise().maxCoeff() - points.rowwise().minCoeff()).norm();
+    ++body.version;
+}
+
+
+void UVLM::Matrix::AICCache::relative_pose
+(
+    const CacheBody& target,
+    const CacheBody& source,
+    UVLM::Types::Matrix3& rotation,
+    UVLM::Types::Vector3& translation
+) const
+{
+    rotation = target.rotation.transpose()*source.rotation;
+    translation = target.rotation.transpose()*(source.translation - target.translation);
+}
+
+
+bool UVLM::Matrix::AICCache::is_valid
+(
+    const CacheBlock& block,
+    const CacheBody& target,
+    const CacheBody& source
+) const
+{
+    if ((!block.valid) ||
+        (block.target_version != target.version) ||
+        (block.source_version != source.version))
+    {
+        return false;
+    }
+    UVLM::Types::Matrix3 rotation;
+    UVLM::Types::Vector3 translation;
+    relative_pose(target, source, rotation, translation);
+
+    const UVLM::Types::Real scale = std::max(target.scale, source.scale);
+    const UVLM::Types::Real error =
+        (rotation - block.rotation).cwiseAbs().maxCoeff()*scale +
+        (translation - block.translation).cwiseAbs().maxCoeff();
+    return error <= UVLM::Constants::POSE_TOLERANCE*scale;
+}
+
+
+void UVLM::Matrix::AICCache::store
+(
+    CacheBlock& block,
+    const CacheBody& target,
+    const CacheBody& source
+)
+{
+    block.valid = true;
+    block.target_version = target.version;
+    block.source_version = source.version;
+    relative_pose(target, source, block.rotation, block.translation);
+}
+
+
+// Copies the first n_rows rows of a lattice into a 3xn matrix of points
+template <typename t_mat>
+UVLM::Types::MatrixX UVLM::Matrix::lattice_points
+(
+    const t_mat& zeta,
+    const uint n_rows
+)
+{
+    const uint n_cols = zeta[0].cols();
+    UVLM::Types::MatrixX points(UVLM::Constants::NDIM, n_rows*n_cols);
+    for (uint i=0; i<n_rows; ++i)
+    {
+        for (uint j=0; j<n_cols; ++j)
+        {
+            for (uint i_dim=0; i_dim<UVLM::Constants::NDIM; ++i_dim)
+            {
+                points(i_dim, i*n_cols + j) = zeta[i_dim](i, j);
+            }
+        }
+    }
+    return points;
+}
+
+
+/*-----------------------------------------------------------------------------
+AIC entries
+-----------------------------------------------------------------------------*/
+template <typename t_zeta,
+          typename t_zeta_col,
+          typename t_zeta_star,
+          typename t_normals>
+UVLM::Matrix::AICEntries<t_zeta, t_zeta_col, t_zeta_star, t_normals>::AICEntries
+(
+    const t_zeta& zeta,
+    const t_zeta_col& zeta_col,
+    const t_zeta_star& zeta_star,
+    const t_normals& normals,
+    const UVLM::Types::VMopts& options,
+    const bool horseshoe
+):
+    zeta(zeta),
+    zeta_col(zeta_col),
+    zeta_star(zeta_star),
+    normals(normals),
+    with_wake(options.Steady),
+    horseshoe(horseshoe),
+    images(UVLM::Types::mirror_images(options))
+{
+    const uint n_surf = options.NumSurfaces;
+    for (uint i_surf=0; i_surf<n_surf; ++i_surf)
+    {
+        const uint M = zeta_col[i_surf][0].rows();
+        const uint N = zeta_col[i_surf][0].cols();
+        for (uint i=0; i<M; ++i)
+        {
+            for (uint j=0; j<N; ++j)
+            {
+                surface_index.push_back(i_surf);
+                i_index.push_back(i);
+                j_index.push_back(j);
+            }
+        }
+    }
+}
+
+
+template <typename t_zeta,
+          typename t_zeta_col,
+          typename t_zeta_star,
+          typename t_normals>
+UVLM::Types::Real UVLM::Matrix::AICEntries<t_zeta, t_zeta_col, t_zeta_star, t_normals>::operator()
+(
+    const uint row,
+    const uint col
+) const
+{
+    const uint icol_surf = surface_index[row];
+    const uint i_col = i_index[row];
+    const uint j_col = j_index[row];
+    UVLM::Types::Vector3 target_triad;
+    target_triad << zeta_col[icol_surf][0](i_col, j_col),
+                    zeta_col[icol_surf][1](i_col, j_col),
+                    zeta_col[icol_surf][2](i_col, j_col);
+
+    const uint ii_surf = surface_index[col];
+    const uint i = i_index[col];
+    const uint j = j_index[col];
+    UVLM::Types::Vector3 uind =
+        UVLM::BiotSavart::vortex_ring(target_triad,
+                                      zeta[ii_surf][0].template block<2,2>(i, j),
+                                      zeta[ii_surf][1].template block<2,2>(i, j),
+                                      zeta[ii_surf][2].template block<2,2>(i, j),
+                                      1.0,
+                                      images);
+    // trailing edge panel: wake column with the same circulation
+    if (with_wake && (i == zeta[ii_surf][0].rows() - 2))
+    {
+        if (horseshoe)
+        {
+            UVLM::BiotSavart::horseshoe(target_triad,
+                                        zeta_star[ii_surf][0].template block<2,2>(0, j),
+                                        zeta_star[ii_surf][1].template block<2,2>(0, j),
+                                        zeta_star[ii_surf][2].template block<2,2>(0, j),
+                                        1.0,
+                                        uind,
+                                        images);
+        } else
+        {
+            const uint mstar = zeta_star[ii_surf][0].rows() - 1;
+            for (uint i_star=0; i_star<mstar; ++i_star)
+            {
+                uind += UVLM::BiotSavart::vortex_ring(target_triad,
+                                              zeta_star[ii_surf][0].template block<2,2>(i_star, j),
+                                              zeta_star[ii_surf][1].template block<2,2>(i_star, j),
+                                              zeta_star[ii_surf][2].template block<2,2>(i_star, j),
+                                              1.0,
+                                              images);
+            }
+        }
+    }
+    return uind(0)*normals[icol_surf][0](i_col, j_col) +
+           uind(1)*normals[icol_surf][1](i_col, j_col) +
+           uind(2)*normals[icol_surf][2](i_col, j_col);
+}
+
+
+template <typename t_zeta,
+          typename t_zeta_col,
+          typename t_zeta_star,
+          typename t_normals>
+UVLM::Types::MatrixX UVLM::Matrix::AICEntries<t_zeta, t_zeta_col, t_zeta_star, t_normals>::points() const
+{
+    UVLM::Types::MatrixX collocation(UVLM::Constants::NDIM, size());
+    for (uint k=0; k<size(); ++k)
+    {
+        for (uint i_dim=0; i_dim<UVLM::Constants::NDIM; ++i_dim)
+        {
+            collocation(i_dim, k) = zeta_col[surface_index[k]][i_dim](i_index[k], j_index[k]);
+        }
+    }
+    return collocation;
+}
+
+
+template <typename t_zeta,
+          typename t_zeta_col,
+          typename t_zeta_star,
+          typename t_normals>
+std::vector<UVLM::HMatrix::BoundingBox> UVLM::Matrix::AICEntries<t_zeta, t_zeta_col, t_zeta_star, t_normals>::source_boxes() const
+{
+    std::vector<UVLM::HMatrix::BoundingBox> boxes(size());
+    for (uint k=0; k<size(); ++k)
+    {
+        const uint i_surf = surface_index[k];
+        const uint i = i_index[k];
+        const uint j = j_index[k];
+        for (uint i_vertex=0; i_vertex<4; ++i_vertex)
+        {
+            boxes[k].extend(UVLM::Types::Vector3(
+                zeta[i_surf][0](i + UVLM::Mapping::vortex_indices(i_vertex, 0), j + UVLM::Mapping::vortex_indices(i_vertex, 1)),
+                zeta[i_surf][1](i + UVLM::Mapping::vortex_indices(i_vertex, 0), j + UVLM::Mapping::vortex_indices(i_vertex, 1)),
+                zeta[i_surf][2](i + UVLM::Mapping::vortex_indices(i_vertex, 0), j + UVLM::Mapping::vortex_indices(i_vertex, 1))));
+        }
+        if (with_wake && (i == zeta[i_surf][0].rows() - 2))
+        {
+            const uint n_rows = horseshoe ? 2 : zeta_star[i_surf][0].rows();
+            for (uint i_star=0; i_star<n_rows; ++i_star)
+            {
+                for (uint j_star=j; j_star<j + 2; ++j_star)
+                {
+                    boxes[k].extend(UVLM::Types::Vector3(zeta_star[i_surf][0](i_star, j_star),
+                                                         zeta_star[i_surf][1](i_star, j_star),
+                                                         zeta_star[i_surf][2](i_star, j_star)));
+                }
+            }
+        }
+    }
+    return boxes;
+}
+
+
 template <typename t_gamma,
           typename t_zeta_col>
 void UVLM::Matrix::reconstruct_gamma
@@ -362,3 +1179,71 @@ void UVLM::Matrix::deconstruct_gamma
     }
 
 }
+
+
+
+/*-----------------------------------------------------------------------------
+Normal velocity at the collocation points induced by every wake panel with
+unit circulation (Ktotal x Kstar_total), so the wake term of the unsteady
+RHS is wash*gamma_star_flat. gamma_star_flat is ordered like gamma_flat.
+-----------------------------------------------------------------------------*/
+template <typename t_zeta_col,
+          typename t_zeta_star,
+          typename t_normals>
+void UVLM::Matrix::wake_normal_wash
+(
+    const t_zeta_col& zeta_col,
+    const t_zeta_star& zeta_star,
+    const t_normals& normals,
+    UVLM::Types::MatrixX& wash,
+    const UVLM::Types::MirrorImages& images
+)
+{
+    const uint n_surf = zeta_col.size();
+    UVLM::Types::VecDimensions dimensions;
+    UVLM::Types::generate_dimensions(zeta_col, dimensions);
+    UVLM::Types::VecDimensions dimensions_star;
+    UVLM::Types::generate_dimensions(zeta_star, dimensions_star, -1);
+    const std::vector<uint> offset = UVLM::Matrix::surface_offsets(dimensions);
+    const std::vector<uint> offset_star = UVLM::Matrix::surface_offsets(dimensions_star);
+    uint Ktotal = 0;
+    uint Kstar_total = 0;
+    for (uint i_surf=0; i_surf<n_surf; ++i_surf)
+    {
+        Ktotal += dimensions[i_surf].first*dimensions[i_surf].second;
+        Kstar_total += dimensions_star[i_surf].first*dimensions_star[i_surf].second;
+    }
+
+    wash.setZero(Ktotal, Kstar_total);
+    for (uint i_surf=0; i_surf<n_surf; ++i_surf)
+    {
+        const uint M = dimensions[i_surf].first;
+        const uint N = dimensions[i_surf].second;
+        #pragma omp parallel for collapse(2)
+        for (uint i=0; i<M; ++i)
+        {
+            for (uint j=0; j<N; ++j)
+            {
+                UVLM::Types::Vector3 collocation_coords;
+                collocation_coords << zeta_col[i_surf][0](i, j),
+                                      zeta_col[i_surf][1](i, j),
+                                      zeta_col[i_surf][2](i, j);
+                UVLM::Types::Vector3 normal;
+                normal << normals[i_surf][0](i, j),
+                          normals[i_surf][1](i, j),
+                          normals[i_surf][2](i, j);
+
+                UVLM::Types::MatrixX u_ind = UVLM::Types::MatrixX::Zero(UVLM::Constants::NDIM, Kstar_total);
+                for (uint ii_surf=0; ii_surf<n_surf; ++ii_surf)
+                {
+                    UVLM::BiotSavart::whole_surface_influence(zeta_star[ii_surf],
+                                                              collocation_coords,
+                                                              u_ind,
+                                                              offset_star[ii_surf],
+                                                              images);
+                }
+                wash.row(offset[i_surf] + i*N + j).noalias() = normal.transpose()*u_ind;
+            }
+        }
+    }
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "EigenInclude.h"
+#include "types.h"
+#include "constants.h"
+
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <cstdint>
+
+// Space-filling curve (Morton, Z-order) ordering of point sets.
+// Points are quantised in their bounding box with 21 bits per coordinate
+// and sorted by the interleaved bits, so that points that are consecutive
+// in the order are close in space. Used to give the tiles of the induced
+// velocity evaluation spatially compact targets and segments.
+namespace UVLM
+{
+    namespace Morton
+    {
+        // bits per coordinate, 3*BITS fit in 64 bits
+        const uint BITS = 21;
+
+        uint64_t spread_bits
+        (
+            uint64_t a
+        );
+
+        // permutation that sorts the rows of points (n x 3) in Morton order:
+        // the i-th point in the order is points.row(order[i])
+        template <typename t_points>
+        std::vector<uint> order
+        (
+            const t_points& points
+        );
+    }
+}
+
+
+// Inserts two zero bits between the BITS lower bits of a
+inline uint64_t UVLM::Morton::spread_bits
+(
+    uint64_t a
+)
+{
+    a &= 0x1fffff;
+    a = (a | a << 32) & 0x1f00000000ffff;
+    a = (a | a << 16) & 0x1f0000ff0000ff;
+    a = (a | a << 8) & 0x100f00f00f00f00f;
+    a = (a | a << 4) & 0x10c30c30c30c30c3;
+    a = (a | a << 2) & 0x1249249249249249;
+    return a;
+}
+
+
+template <typename t_points>
+std::vector<uint> UVLM::Morton::order
+(
+    const t_points& points
+)
+{
+    const uint n_points = points.rows();
+    std::vector<uint> permutation(n_points);
+    std::iota(permutation.begin(), permutation.end(), 0);
+    if (n_points < 2) {return permutation;}
+
+    UVLM::Types::Vector3 min = points.row(0).transpose();
+    UVLM::Types::Vector3 max = min;
+    for (uint i_point=1; i_point<n_points; ++i_point)
+    {
+        min = min.cwiseMin(points.row(i_point).transpose());
+        max = max.cwiseMax(points.row(i_point).transpose());
+    }
+    const UVLM::Types::Real n_cells = UVLM::Types::Real((1u << BITS) - 1);
+    UVLM::Types::Vector3 scale;
+    for (uint i_dim=0; i_dim<UVLM::Constants::NDIM; ++i_dim)
+    {
+        const UVLM::Types::Real length = max(i_dim) - min(i_dim);
+        scale(i_dim) = (length > 0.0) ? n_cells/length : 0.0;
+    }
+
+    std::vector<uint64_t> codes(n_points);
+    for (uint i_point=0; i_point<n_points; ++i_point)
+    {
+        uint64_t code = 0;
+        for (uint i_dim=0; i_dim<UVLM::Constants::NDIM; ++i_dim)
+        {
+            const uint64_t cell = uint64_t((points(i_point, i_dim) - min(i_dim))*scale(i_dim));
+            code |= UVLM::Morton::spread_bits(cell) << i_dim;
+        }
+        codes[i_point] = code;
+    }
+    std::sort(permutation.begin(),
+              permutation.end(),
+              [&codes](const uint a, const uint b) {return codes[a] < codes[b];});
+    return permutation;
+}
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <cmath>
+#include <vector>
+#include <algorithm>
 #include "EigenInclude.h"
 #include "types.h"
 #include "unsteady_utils.h"
@@ -29,6 +31,7 @@ namespace UVLM
         {
             // Set forces to 0
             UVLM::Types::initialise_VecVecMat(forces);
+            const UVLM::Types::MirrorImages images = UVLM::Types::mirror_images(options);
 
             // first calculate all the velocities at the corner points
             UVLM::Types::VecVecMatrixX velocities;
@@ -46,6 +49,19 @@ namespace UVLM
             UVLM::Types::Vector3 rp;
             uint start;
             uint end;
+            // the steady wake of ring vortices is a lattice like the
+            // unsteady one, the horseshoe legs are evaluated panel by panel
+            UVLM::BiotSavart::SegmentTable segments;
+            if (!options.horseshoe)
+            {
+                for (uint i_surf=0; i_surf<n_surf; ++i_surf)
+                {
+                    segments.add_surface(zeta[i_surf],
+                                         zeta_star[i_surf],
+                                         gamma[i_surf],
+                                         gamma_star[i_surf]);
+                }
+            }
             for (uint i_surf=0; i_surf<n_surf; ++i_surf)
             {
                 const uint M = gamma[i_surf].rows();
@@ -83,27 +99,33 @@ namespace UVLM
                             rp = 0.5*(r1 + r2);
 
                             // induced vel by vortices at vp
-                            v_ind.setZero();
-                            for (uint ii_surf=0; ii_surf<n_surf; ++ii_surf)
+                            if (!options.horseshoe)
                             {
-                                UVLM::Types::VecMatrixX temp_uout;
-                                UVLM::Types::allocate_VecMat(temp_uout,
-                                                             zeta[ii_surf],
-                                                             -1);
-                                UVLM::BiotSavart::surface_with_steady_wake
-                                (
-                                    zeta[ii_surf],
-                                    zeta_star[ii_surf],
-                                    gamma[ii_surf],
-                                    gamma_star[ii_surf],
-                                    rp,
-                                    options.horseshoe,
-                                    temp_uout,
-                                    options.ImageMethod
-                                );
-                                v_ind(0) += temp_uout[0].sum();
-                                v_ind(1) += temp_uout[1].sum();
-                                v_ind(2) += temp_uout[2].sum();
+                                v_ind = segments.induced_velocity(rp, images);
+                            } else
+                            {
+                                v_ind.setZero();
+                                for (uint ii_surf=0; ii_surf<n_surf; ++ii_surf)
+                                {
+                                    UVLM::Types::VecMatrixX temp_uout;
+                                    UVLM::Types::allocate_VecMat(temp_uout,
+                                                                 zeta[ii_surf],
+                                                                 -1);
+                                    UVLM::BiotSavart::surface_with_steady_wake
+                                    (
+                                        zeta[ii_surf],
+                                        zeta_star[ii_surf],
+                                        gamma[ii_surf],
+                                        gamma_star[ii_surf],
+                                        rp,
+                                        options.horseshoe,
+                                        temp_uout,
+                                        images
+                                    );
+                                    v_ind(0) += temp_uout[0].sum();
+                                    v_ind(1) += temp_uout[1].sum();
+                                    v_ind(2) += temp_uout[2].sum();
+                                }
                             }
 
                             dl = r2 - r1;
@@ -134,25 +156,289 @@ namespace UVLM
             }
         }
 
+        // Velocity induced by the bound and wake vortices at the midpoint
+        // of every segment of the lattice: span_v_ind[i_surf][i_dim] is
+        // MxN (spanwise segments, the trailing edge ones do not get forces)
+        // and chord_v_ind[i_surf][i_dim] is Mx(N+1) (chordwise segments).
         template <typename t_zeta,
-                  typename t_zeta_dot,
                   typename t_zeta_star,
                   typename t_gamma,
-                  typename t_gamma_star,
+                  typename t_gamma_star>
+        void segment_induced_velocities
+        (
+            const t_zeta& zeta,
+            const t_zeta_star& zeta_star,
+            const t_gamma& gamma,
+            const t_gamma_star& gamma_star,
+            UVLM::Types::VecVecMatrixX& span_v_ind,
+            UVLM::Types::VecVecMatrixX& chord_v_ind,
+            const UVLM::Types::VMopts options
+        )
+        {
+            const uint n_surf = zeta.size();
+            const UVLM::Types::MirrorImages images = UVLM::Types::mirror_images(options);
+            // bound and wake segments, shared by all the midpoints
+            UVLM::BiotSavart::SegmentTable segments;
+            for (uint i_surf=0; i_surf<n_surf; ++i_surf)
+            {
+                segments.add_surface(zeta[i_surf],
+                                     zeta_star[i_surf],
+                                     gamma[i_surf],
+                                     gamma_star[i_surf]);
+            }
+            span_v_ind.resize(n_surf);
+            chord_v_ind.resize(n_surf);
+            for (uint i_surf=0; i_surf<n_surf; ++i_surf)
+            {
+                const uint M = gamma[i_surf].rows();
+                const uint N = gamma[i_surf].cols();
+                span_v_ind[i_surf].assign(UVLM::Constants::NDIM,
+                                          UVLM::Types::MatrixX::Zero(M, N));
+                chord_v_ind[i_surf].assign(UVLM::Constants::NDIM,
+                                           UVLM::Types::MatrixX::Zero(M, N+1));
+
+                #pragma omp parallel for collapse(2)
+                for (uint i_M=0; i_M<M; ++i_M)
+                {
+                    for (uint i_N=0; i_N<N+1; ++i_N)
+                    {
+                        UVLM::Types::Vector3 v_ind;
+                        UVLM::Types::Vector3 rp;
+                        UVLM::Types::Vector3 r1;
+                        UVLM::Types::Vector3 r2;
+
+                        r1 << zeta[i_surf][0](i_M, i_N),
+                              zeta[i_surf][1](i_M, i_N),
+                              zeta[i_surf][2](i_M, i_N);
+                        // Spanwise vortices
+                        if (i_N < N)
+                        {
+                            r2 << zeta[i_surf][0](i_M, i_N+1),
+                                  zeta[i_surf][1](i_M, i_N+1),
+                                  zeta[i_surf][2](i_M, i_N+1);
+
+                            // position of the center point of the vortex filament
+                            rp = 0.5*(r1 + r2);
+
+                            // induced vel by vortices at vp
+                            v_ind = segments.induced_velocity(rp, images);
+                            for (uint i_dim=0; i_dim<UVLM::Constants::NDIM; ++i_dim)
+                            {
+                                span_v_ind[i_surf][i_dim](i_M, i_N) = v_ind(i_dim);
+                            }
+                        }
+
+                        // Chordwise vortices
+                        r2 << zeta[i_surf][0](i_M+1, i_N),
+                              zeta[i_surf][1](i_M+1, i_N),
+                              zeta[i_surf][2](i_M+1, i_N);
+
+                        rp = 0.5*(r1 + r2);
+
+                        v_ind = segments.induced_velocity(rp, images);
+                        for (uint i_dim=0; i_dim<UVLM::Constants::NDIM; ++i_dim)
+                        {
+                            chord_v_ind[i_surf][i_dim](i_M, i_N) = v_ind(i_dim);
+                        }
+                    }
+                }
+            }
+        }
+
+        // number of segment midpoints per block of the ensemble influence
+        // matrix, it bounds its memory to 3*ENSEMBLE_BLOCK*(K + Kstar)
+        const uint ENSEMBLE_BLOCK = 256;
+
+        // segment_induced_velocities for an ensemble of cases that share
+        // the bound and wake geometry and only differ in the circulation.
+        // The velocities of every block of midpoints are computed for all
+        // the cases at once as the product of the (unit circulation)
+        // influence matrix of the block and the circulations of the cases.
+        template <typename t_zeta,
+                  typename t_zeta_star,
+                  typename t_gamma,
+                  typename t_gamma_star>
+        void segment_induced_velocities_ensemble
+        (
+            const t_zeta& zeta,
+            const t_zeta_star& zeta_star,
+            const t_gamma& gamma,
+            const t_gamma_star& gamma_star,
+            std::vector<UVLM::Types::VecVecMatrixX>& span_v_ind,
+            std::vector<UVLM::Types::VecVecMatrixX>& chord_v_ind,
+            const UVLM::Types::MirrorImages& images = UVLM::Types::MirrorImages()
+        )
+        {
+            const uint n_cases = gamma.size();
+            const uint n_surf = zeta.size();
+
+            // offsets of the bound and wake circulations
+            std::vector<uint> offset(n_surf);
+            std::vector<uint> offset_star(n_surf);
+            uint n_gamma = 0;
+            for (uint i_surf=0; i_surf<n_surf; ++i_surf)
+            {
+                offset[i_surf] = n_gamma;
+                n_gamma += gamma[0][i_surf].size();
+            }
+            for (uint i_surf=0; i_surf<n_surf; ++i_surf)
+            {
+                offset_star[i_surf] = n_gamma;
+                n_gamma += gamma_star[0][i_surf].size();
+            }
+
+            UVLM::Types::MatrixX circulation(n_gamma, n_cases);
+            for (uint i_case=0; i_case<n_cases; ++i_case)
+            {
+                for (uint i_surf=0; i_surf<n_surf; ++i_surf)
+                {
+                    const uint N = gamma[i_case][i_surf].cols();
+                    for (uint i=0; i<gamma[i_case][i_surf].rows(); ++i)
+                    {
+                        for (uint j=0; j<N; ++j)
+                        {
+                            circulation(offset[i_surf] + i*N + j, i_case) = gamma[i_case][i_surf](i, j);
+                        }
+                    }
+                    const uint N_star = gamma_star[i_case][i_surf].cols();
+                    for (uint i=0; i<gamma_star[i_case][i_surf].rows(); ++i)
+                    {
+                        for (uint j=0; j<N_star; ++j)
+                        {
+                            circulation(offset_star[i_surf] + i*N_star + j, i_case) = gamma_star[i_case][i_surf](i, j);
+                        }
+                    }
+                }
+            }
+
+            // midpoints: (surface, row, column, chordwise)
+            std::vector<uint> point_surf;
+            std::vector<uint> point_i;
+            std::vector<uint> point_j;
+            std::vector<bool> point_chordwise;
+            span_v_ind.resize(n_cases);
+            chord_v_ind.resize(n_cases);
+            for (uint i_surf=0; i_surf<n_surf; ++i_surf)
+            {
+                const uint M = gamma[0][i_surf].rows();
+                const uint N = gamma[0][i_surf].cols();
+                for (uint i_case=0; i_case<n_cases; ++i_case)
+                {
+                    span_v_ind[i_case].resize(n_surf);
+                    chord_v_ind[i_case].resize(n_surf);
+                    span_v_ind[i_case][i_surf].assign(UVLM::Constants::NDIM,
+                                                      UVLM::Types::MatrixX::Zero(M, N));
+                    chord_v_ind[i_case][i_surf].assign(UVLM::Constants::NDIM,
+                                                       UVLM::Types::MatrixX::Zero(M, N+1));
+                }
+                for (uint i_M=0; i_M<M; ++i_M)
+                {
+                    for (uint i_N=0; i_N<N+1; ++i_N)
+                    {
+                        if (i_N < N)
+                        {
+                            point_surf.push_back(i_surf);
+                            point_i.push_back(i_M);
+                            point_j.push_back(i_N);
+                            point_chordwise.push_back(false);
+                        }
+                        point_surf.push_back(i_surf);
+                        point_i.push_back(i_M);
+                        point_j.push_back(i_N);
+                        point_chordwise.push_back(true);
+                    }
+                }
+            }
+
+            const uint n_points = point_surf.size();
+            UVLM::Types::MatrixX influence;
+            UVLM::Types::MatrixX v_ind;
+            for (uint first=0; first<n_points; first+=ENSEMBLE_BLOCK)
+            {
+                const uint n_block = std::min(ENSEMBLE_BLOCK, n_points - first);
+                influence.setZero(UVLM::Constants::NDIM*n_block, n_gamma);
+
+                #pragma omp parallel for
+                for (uint i_point=0; i_point<n_block; ++i_point)
+                {
+                    const uint i_surf = point_surf[first + i_point];
+                    const uint i_M = point_i[first + i_point];
+                    const uint i_N = point_j[first + i_point];
+                    UVLM::Types::Vector3 r1;
+                    UVLM::Types::Vector3 r2;
+                    r1 << zeta[i_surf][0](i_M, i_N),
+                          zeta[i_surf][1](i_M, i_N),
+                          zeta[i_surf][2](i_M, i_N);
+                    if (point_chordwise[first + i_point])
+                    {
+                        r2 << zeta[i_surf][0](i_M+1, i_N),
+                              zeta[i_surf][1](i_M+1, i_N),
+                              zeta[i_surf][2](i_M+1, i_N);
+                    } else
+                    {
+                        r2 << zeta[i_surf][0](i_M, i_N+1),
+                              zeta[i_surf][1](i_M, i_N+1),
+                              zeta[i_surf][2](i_M, i_N+1);
+                    }
+                    const UVLM::Types::Vector3 rp = 0.5*(r1 + r2);
+
+                    auto point_rows = influence.middleRows(UVLM::Constants::NDIM*i_point,
+                                                           UVLM::Constants::NDIM);
+                    for (uint ii_surf=0; ii_surf<n_surf; ++ii_surf)
+                    {
+                        UVLM::BiotSavart::whole_surface_influence(zeta[ii_surf],
+                                                                  rp,
+                                                                  point_rows,
+                                                                  offset[ii_surf],
+                                                                  images);
+                        UVLM::BiotSavart::whole_surface_influence(zeta_star[ii_surf],
+                                                                  rp,
+                                                                  point_rows,
+                                                                  offset_star[ii_surf],
+                                                                  images);
+                    }
+                }
+
+                v_ind.noalias() = influence*circulation;
+
+                for (uint i_point=0; i_point<n_block; ++i_point)
+                {
+                    const uint i_surf = point_surf[first + i_point];
+                    const uint i_M = point_i[first + i_point];
+                    const uint i_N = point_j[first + i_point];
+                    for (uint i_case=0; i_case<n_cases; ++i_case)
+                    {
+                        UVLM::Types::VecMatrixX& out = point_chordwise[first + i_point] ?
+                                                       chord_v_ind[i_case][i_surf] :
+                                                       span_v_ind[i_case][i_surf];
+                        for (uint i_dim=0; i_dim<UVLM::Constants::NDIM; ++i_dim)
+                        {
+                            out[i_dim](i_M, i_N) = v_ind(UVLM::Constants::NDIM*i_point + i_dim, i_case);
+                        }
+                    }
+                }
+            }
+        }
+
+        // Kutta-Joukowski forces on the segments with the induced
+        // velocities given by segment_induced_velocities, transferred
+        // to the nodes of the lattice.
+        template <typename t_zeta,
+                  typename t_zeta_dot,
+                  typename t_gamma,
                   typename t_uext,
                   typename t_rbm_velocity,
                   typename t_forces>
-        void calculate_static_forces_unsteady
+        void static_forces_from_induced_velocities
         (
             const t_zeta& zeta,
             const t_zeta_dot& zeta_dot,
-            const t_zeta_star& zeta_star,
             const t_gamma& gamma,
-            const t_gamma_star& gamma_star,
             const t_uext& uext,
             const t_rbm_velocity& rbm_velocity,
+            const UVLM::Types::VecVecMatrixX& span_v_ind,
+            const UVLM::Types::VecVecMatrixX& chord_v_ind,
             t_forces&  forces,
-            const UVLM::Types::VMopts options,
             const UVLM::Types::FlightConditions& flightconditions
         )
         {
@@ -175,8 +461,6 @@ namespace UVLM
                 velocities
             );
 
-            // not bothered with effciency.
-            // if it is so critical, it could be improved
             const uint n_surf = zeta.size();
 
             UVLM::Types::VecVecMatrixX span_seg_forces;
@@ -190,120 +474,56 @@ namespace UVLM
                 UVLM::Types::allocate_VecVecMat(span_seg_forces, 1, 3, M+1, N);
                 UVLM::Types::allocate_VecVecMat(chord_seg_forces, 1, 3, M, N+1);
 
-                // UVLM::Types::Vector3 dl;
-                // UVLM::Types::Vector3 v;
-                // UVLM::Types::Vector3 f;
-                // UVLM::Types::Vector3 v_ind;
-                // UVLM::Types::Vector3 rp;
-                // UVLM::Types::Vector3 r1;
-                // UVLM::Types::Vector3 r2;
-                // UVLM::Types::Real delta_gamma;
-
-                // Computation of induced velocity in each segment
-                #pragma omp parallel for collapse(2)
+                UVLM::Types::Vector3 dl;
+                UVLM::Types::Vector3 v;
+                UVLM::Types::Vector3 f;
+                UVLM::Types::Vector3 v_ind;
+                UVLM::Types::Vector3 r1;
+                UVLM::Types::Vector3 r2;
+                UVLM::Types::Real delta_gamma;
                 for (uint i_M=0; i_M<M; ++i_M)
                 {
-                    for (uint i_N=0; i_N<N; ++i_N)
+                    for (uint i_N=0; i_N<N+1; ++i_N)
                     {
-                        UVLM::Types::Vector3 dl;
-                        UVLM::Types::Vector3 v;
-                        UVLM::Types::Vector3 f;
-                        UVLM::Types::Vector3 v_ind;
-                        UVLM::Types::Vector3 rp;
-                        UVLM::Types::Vector3 r1;
-                        UVLM::Types::Vector3 r2;
-                        UVLM::Types::Real delta_gamma;
-
-                        // Spanwise vortices
                         r1 << zeta[i_surf][0](i_M, i_N),
                               zeta[i_surf][1](i_M, i_N),
                               zeta[i_surf][2](i_M, i_N);
-                        r2 << zeta[i_surf][0](i_M, i_N+1),
-                              zeta[i_surf][1](i_M, i_N+1),
-                              zeta[i_surf][2](i_M, i_N+1);
-
-                        // position of the center point of the vortex filament
-                        rp = 0.5*(r1 + r2);
-
-                        // induced vel by vortices at vp
-                        v_ind.setZero();
-                        for (uint ii_surf=0; ii_surf<n_surf; ++ii_surf)
+                        // Spanwise vortices
+                        if (i_N < N)
                         {
-                            v_ind += UVLM::BiotSavart::whole_surface(zeta[ii_surf],
-                                                                              gamma[ii_surf],
-                                                                              rp,
-                                                                              0,
-                                                                              0,
-                                                                              -1,
-                                                                              -1,
-                                                                              options.ImageMethod);
-
-                            v_ind += UVLM::BiotSavart::whole_surface(zeta_star[ii_surf],
-                                                                              gamma_star[ii_surf],
-                                                                              rp,
-                                                                              0,
-                                                                              0,
-                                                                              -1,
-                                                                              -1,
-                                                                              options.ImageMethod);
-                        }
+                            r2 << zeta[i_surf][0](i_M, i_N+1),
+                                  zeta[i_surf][1](i_M, i_N+1),
+                                  zeta[i_surf][2](i_M, i_N+1);
+                            dl = r2-r1;
+
+                            v << 0.5*(velocities[i_surf][0](i_M, i_N) +
+                                      velocities[i_surf][0](i_M, i_N+1)),
+                                 0.5*(velocities[i_surf][1](i_M, i_N) +
+                                      velocities[i_surf][1](i_M, i_N+1)),
+                                 0.5*(velocities[i_surf][2](i_M, i_N) +
+                                      velocities[i_surf][2](i_M, i_N+1));
+                            v_ind << span_v_ind[i_surf][0](i_M, i_N),
+                                     span_v_ind[i_surf][1](i_M, i_N),
+                                     span_v_ind[i_surf][2](i_M, i_N);
 
-                        dl = r2-r1;
-
-                        v << 0.5*(velocities[i_surf][0](i_M, i_N) +
-                                  velocities[i_surf][0](i_M, i_N+1)),
-                             0.5*(velocities[i_surf][1](i_M, i_N) +
-                                  velocities[i_surf][1](i_M, i_N+1)),
-                             0.5*(velocities[i_surf][2](i_M, i_N) +
-                                  velocities[i_surf][2](i_M, i_N+1));
+                            v = (v + v_ind).eval();
 
-                        v = (v + v_ind).eval();
+                            if (i_M == 0){
+                                delta_gamma = -gamma[i_surf](i_M, i_N);
+                            } else {
+                                delta_gamma = gamma[i_surf](i_M-1, i_N) - gamma[i_surf](i_M, i_N);
+                            }
 
-                        if (i_M == 0){
-                            delta_gamma = -gamma[i_surf](i_M, i_N);
-                        } else if (i_M == M){
-                            // Might be needed if TE forces are computed
-                            delta_gamma = gamma[i_surf](i_M-1, i_N);
-                        } else {
-                            delta_gamma = gamma[i_surf](i_M-1, i_N) - gamma[i_surf](i_M, i_N);
+                            f = flightconditions.rho*delta_gamma*v.cross(dl);
+                            span_seg_forces[0][0](i_M, i_N) = f(0);
+                            span_seg_forces[0][1](i_M, i_N) = f(1);
+                            span_seg_forces[0][2](i_M, i_N) = f(2);
                         }
 
-                        f = flightconditions.rho*delta_gamma*v.cross(dl);
-                        span_seg_forces[0][0](i_M, i_N) = f(0);
-                        span_seg_forces[0][1](i_M, i_N) = f(1);
-                        span_seg_forces[0][2](i_M, i_N) = f(2);
-
-                        // Chordwise vortice
+                        // Chordwise vortices
                         r2 << zeta[i_surf][0](i_M+1, i_N),
                               zeta[i_surf][1](i_M+1, i_N),
                               zeta[i_surf][2](i_M+1, i_N);
-
-                        // position of the center point of the vortex filament
-                        rp = 0.5*(r1 + r2);
-
-                        // induced vel by vortices at vp
-                        v_ind.setZero();
-                        for (uint ii_surf=0; ii_surf<n_surf; ++ii_surf)
-                        {
-                            v_ind += UVLM::BiotSavart::whole_surface(zeta[ii_surf],
-                                                                              gamma[ii_surf],
-                                                                              rp,
-                                                                              0,
-                                                                              0,
-                                                                              -1,
-                                                                              -1,
-                                                                              options.ImageMethod);
-
-                            v_ind += UVLM::BiotSavart::whole_surface(zeta_star[ii_surf],
-                                                                              gamma_star[ii_surf],
-                                                                              rp,
-                                                                              0,
-                                                                              0,
-                                                                              -1,
-                                                                              -1,
-                                                                              options.ImageMethod);
-                        }
-
                         dl = r2-r1;
 
                         v << 0.5*(velocities[i_surf][0](i_M, i_N) +
@@ -312,6 +532,9 @@ namespace UVLM
                                   velocities[i_surf][1](i_M+1, i_N)),
                              0.5*(velocities[i_surf][2](i_M, i_N) +
                                   velocities[i_surf][2](i_M+1, i_N));
+                        v_ind << chord_v_ind[i_surf][0](i_M, i_N),
+                                 chord_v_ind[i_surf][1](i_M, i_N),
+                                 chord_v_ind[i_surf][2](i_M, i_N);
 
                         v = (v + v_ind).eval();
 
@@ -330,71 +553,6 @@ namespace UVLM
                     }
                 }
 
-                // Influence of the last chordwise column of vortices
-                UVLM::Types::Vector3 dl;
-                UVLM::Types::Vector3 v;
-                UVLM::Types::Vector3 f;
-                UVLM::Types::Vector3 v_ind;
-                UVLM::Types::Vector3 rp;
-                UVLM::Types::Vector3 r1;
-                UVLM::Types::Vector3 r2;
-                UVLM::Types::Real delta_gamma;
-                for (uint i_M=0; i_M<M; ++i_M){
-
-                    r1 << zeta[i_surf][0](i_M, N),
-                          zeta[i_surf][1](i_M, N),
-                          zeta[i_surf][2](i_M, N);
-                    r2 << zeta[i_surf][0](i_M+1, N),
-                          zeta[i_surf][1](i_M+1, N),
-                          zeta[i_surf][2](i_M+1, N);
-
-                    // position of the center point of the vortex filament
-                    rp = 0.5*(r1 + r2);
-
-                    // induced vel by vortices at vp
-                    v_ind.setZero();
-
-                    for (uint ii_surf=0; ii_surf<n_surf; ++ii_surf)
-                    {
-                        v_ind += UVLM::BiotSavart::whole_surface(zeta[ii_surf],
-                                                                          gamma[ii_surf],
-                                                                          rp,
-                                                                          0,
-                                                                          0,
-                                                                          -1,
-                                                                          -1,
-                                                                          options.ImageMethod);
-
-                        v_ind += UVLM::BiotSavart::whole_surface(zeta_star[ii_surf],
-                                                                          gamma_star[ii_surf],
-                                                                          rp,
-                                                                          0,
-                                                                          0,
-                                                                          -1,
-                                                                          -1,
-                                                                          options.ImageMethod);
-                    }
-
-                    dl = r2-r1;
-
-                    v << 0.5*(velocities[i_surf][0](i_M, N) +
-                              velocities[i_surf][0](i_M+1, N)),
-                         0.5*(velocities[i_surf][1](i_M, N) +
-                              velocities[i_surf][1](i_M+1, N)),
-                         0.5*(velocities[i_surf][2](i_M, N) +
-                              velocities[i_surf][2](i_M+1, N));
-
-                    v = (v + v_ind).eval();
-
-                    delta_gamma = -gamma[i_surf](i_M, N-1);
-                    f = flightconditions.rho*delta_gamma*v.cross(dl);
-                    chord_seg_forces[0][0](i_M, N) = f(0);
-                    chord_seg_forces[0][1](i_M, N) = f(1);
-                    chord_seg_forces[0][2](i_M, N) = f(2);
-
-                }
-
-                // #pragma omp parallel for collapse(2) reduction(sum_Vector3: uout)
                 // Transfer forces to nodes
                 for (uint i_M=0; i_M<M+1; ++i_M)
                 {
@@ -423,6 +581,48 @@ namespace UVLM
             }
         }
 
+        template <typename t_zeta,
+                  typename t_zeta_dot,
+                  typename t_zeta_star,
+                  typename t_gamma,
+                  typename t_gamma_star,
+                  typename t_uext,
+                  typename t_rbm_velocity,
+                  typename t_forces>
+        void calculate_static_forces_unsteady
+        (
+            const t_zeta& zeta,
+            const t_zeta_dot& zeta_dot,
+            const t_zeta_star& zeta_star,
+            const t_gamma& gamma,
+            const t_gamma_star& gamma_star,
+            const t_uext& uext,
+            const t_rbm_velocity& rbm_velocity,
+            t_forces&  forces,
+            const UVLM::Types::VMopts options,
+            const UVLM::Types::FlightConditions& flightconditions
+        )
+        {
+            UVLM::Types::VecVecMatrixX span_v_ind;
+            UVLM::Types::VecVecMatrixX chord_v_ind;
+            segment_induced_velocities(zeta,
+                                       zeta_star,
+                                       gamma,
+                                       gamma_star,
+                                       span_v_ind,
+                                       chord_v_ind,
+                                       options);
+            static_forces_from_induced_velocities(zeta,
+                                                  zeta_dot,
+                                                  gamma,
+                                                  uext,
+                                                  rbm_velocity,
+                                                  span_v_ind,
+                                                  chord_v_ind,
+                                                  forces,
+                                                  flightconditions);
+        }
+
         // Forces is not set to 0, forces are added
         template <typename t_zeta,
                   typename t_zeta_star,
@@ -10,10 +10,14 @@
 #include "wake.h"
 #include "postproc.h"
 #include "linear_solver.h"
+#include "toeplitz.h"
 
 #include "debugutils.h"
 
 #include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cmath>
 
 // DECLARATIONS
 namespace UVLM
@@ -40,6 +44,24 @@ namespace UVLM
             const UVLM::Types::FlightConditions& flightconditions
         );
 
+        template <typename t_zeta,
+                  typename t_uext,
+                  typename t_zeta_star,
+                  typename t_gamma,
+                  typename t_gamma_star,
+                  typename t_forces>
+        void solver_batch
+        (
+            t_zeta& zeta,
+            t_uext& uext,
+            t_zeta_star& zeta_star,
+            t_gamma& gamma,
+            t_gamma_star& gamma_star,
+            t_forces& forces,
+            const UVLM::Types::VMopts& options,
+            const UVLM::Types::FlightConditions& flightconditions
+        );
+
         template <typename t_zeta,
                   typename t_zeta_col,
                   typename t_uext_col,
@@ -206,7 +228,10 @@ void UVLM::Steady::solver
             zeta_star,
             gamma,
             gamma_star,
-            u_ind);
+            u_ind,
+            UVLM::Types::mirror_images(options),
+            options.morton_order,
+            options.single_precision_convection);
         // convection velocity of the background flow
         for (uint i_surf=0; i_surf<zeta.size(); ++i_surf)
         {
@@ -332,30 +357,48 @@ void UVLM::Steady::solve_horseshoe
                       rhs,
                       Ktotal);
 
-    // AIC generation
-    UVLM::Types::MatrixX aic = UVLM::Types::MatrixX::Zero(Ktotal, Ktotal);
-    UVLM::Matrix::AIC(Ktotal,
-                      zeta,
-                      zeta_col,
-                      zeta_star,
-                      uext_col,
-                      normals,
-                      options,
-                      true,
-                      aic);
-
     UVLM::Types::VectorX gamma_flat;
     UVLM::Matrix::deconstruct_gamma(gamma,
                                     gamma_flat,
                                     zeta_col);
 
-    UVLM::LinearSolver::solve_system
-    (
-        aic,
-        rhs,
-        options,
-        gamma_flat
-    );
+    bool structured = false;
+    if (options.toeplitz)
+    {
+        structured = UVLM::Toeplitz::solve(zeta,
+                                           zeta_col,
+                                           zeta_star,
+                                           normals,
+                                           options,
+                                           true,
+                                           rhs,
+                                           gamma_flat);
+    }
+    if (!structured)
+    {
+        // AIC generation
+        UVLM::Types::MatrixX aic = UVLM::Types::MatrixX::Zero(Ktotal, Ktotal);
+        UVLM::Matrix::AIC(Ktotal,
+                          zeta,
+                          zeta_col,
+                          zeta_star,
+                          uext_col,
+                          normals,
+                          options,
+                          true,
+                          aic);
+
+        UVLM::Types::VecDimensions dimensions;
+        UVLM::Types::generate_dimensions(zeta_col, dimensions);
+        UVLM::LinearSolver::solve_system
+        (
+            aic,
+            rhs,
+            options,
+            UVLM::LinearSolver::generate_layout(dimensions),
+            gamma_flat
+        );
+    }
 
     // probably could be done better with a Map
     UVLM::Matrix::reconstruct_gamma(gamma_flat,
@@ -406,7 +449,6 @@ void UVLM::Steady::solve_discretised
     const uint Ktotal = ii;
 
     UVLM::Types::VectorX rhs;
-    UVLM::Types::MatrixX aic = UVLM::Types::MatrixX::Zero(Ktotal, Ktotal);
     // RHS generation
     UVLM::Matrix::RHS(zeta_col,
                       zeta_star,
@@ -417,31 +459,68 @@ void UVLM::Steady::solve_discretised
                       rhs,
                       Ktotal);
 
-    // AIC generation
-    UVLM::Matrix::AIC(Ktotal,
-                      zeta,
-                      zeta_col,
-                      zeta_star,
-                      uext_col,
-                      normals,
-                      options,
-                      false,
-                      aic);
-
     // linear system solution
     UVLM::Types::VectorX gamma_flat;
     UVLM::Matrix::deconstruct_gamma(gamma,
                                     gamma_flat,
                                     zeta_col);
 
+    bool structured = false;
+    if (options.toeplitz)
+    {
+        // Toeplitz AIC if the lattice is uniform
+        structured = UVLM::Toeplitz::solve(zeta,
+                                           zeta_col,
+                                           zeta_star,
+                                           normals,
+                                           options,
+                                           false,
+                                           rhs,
+                                           gamma_flat);
+    }
 
-    UVLM::LinearSolver::solve_system
-    (
-        aic,
-        rhs,
-        options,
-        gamma_flat
-    );
+    if (structured)
+    {
+        // solved with the structured AIC
+    } else if (options.hmatrix)
+    {
+        // compressed AIC, the dense matrix is never assembled
+        const UVLM::Matrix::AICEntries<t_zeta, t_zeta_col, t_zeta_star, t_normals>
+            entries(zeta,
+                    zeta_col,
+                    zeta_star,
+                    normals,
+                    options,
+                    false);
+        UVLM::HMatrix::solve(entries,
+                             rhs,
+                             options.hmatrix_tol,
+                             gamma_flat);
+    } else
+    {
+        // AIC generation
+        UVLM::Types::MatrixX aic = UVLM::Types::MatrixX::Zero(Ktotal, Ktotal);
+        UVLM::Matrix::AIC(Ktotal,
+                          zeta,
+                          zeta_col,
+                          zeta_star,
+                          uext_col,
+                          normals,
+                          options,
+                          false,
+                          aic);
+
+        UVLM::Types::VecDimensions dimensions;
+        UVLM::Types::generate_dimensions(zeta_col, dimensions);
+        UVLM::LinearSolver::solve_system
+        (
+            aic,
+            rhs,
+            options,
+            UVLM::LinearSolver::generate_layout(dimensions),
+            gamma_flat
+        );
+    }
 
     // gamma flat to gamma
     // probably could be done better with a Map
@@ -461,3 +540,205 @@ void UVLM::Steady::solve_discretised
                                                 in_n_rows);
     }
 }
+
+
+
+/*-----------------------------------------------------------------------------
+Steady solution of several cases on the same lattice (polar and trim sweeps).
+uext, zeta_star, gamma, gamma_star and forces hold one entry per case.
+The AIC only depends on the wake geometry, so it is assembled once for every
+group of cases that share the wake spacing (all of them for horseshoe wakes),
+and the right-hand sides of the group are solved together.
+Cases with wake rollup are solved one by one.
+-----------------------------------------------------------------------------*/
+template <typename t_zeta,
+          typename t_uext,
+          typename t_zeta_star,
+          typename t_gamma,
+          typename t_gamma_star,
+          typename t_forces>
+void UVLM::Steady::solver_batch
+(
+    t_zeta& zeta,
+    t_uext& uext,
+    t_zeta_star& zeta_star,
+    t_gamma& gamma,
+    t_gamma_star& gamma_star,
+    t_forces& forces,
+    const UVLM::Types::VMopts& options,
+    const UVLM::Types::FlightConditions& flightconditions
+)
+{
+    const uint n_cases = uext.size();
+    if (n_cases == 0) {return;}
+
+    if ((options.n_rollup != 0 && !options.horseshoe) || options.hmatrix || options.toeplitz)
+    {
+        // the wake depends on every case, or the AIC is not assembled
+        UVLM::Types::VecVecMatrixX zeta_dot;
+        UVLM::Types::allocate_VecVecMat(zeta_dot, zeta);
+        for (uint i_case=0; i_case<n_cases; ++i_case)
+        {
+            UVLM::Steady::solver(zeta,
+                                 zeta_dot,
+                                 uext[i_case],
+                                 zeta_star[i_case],
+                                 gamma[i_case],
+                                 gamma_star[i_case],
+                                 forces[i_case],
+                                 options,
+                                 flightconditions);
+        }
+        return;
+    }
+
+    // lattice information shared by all the cases
+    UVLM::Types::VecVecMatrixX zeta_col;
+    UVLM::Geometry::generate_colocationMesh(zeta, zeta_col);
+
+    UVLM::Types::VecVecMatrixX normals;
+    UVLM::Types::allocate_VecVecMat(normals, zeta_col);
+    UVLM::Geometry::generate_surfaceNormal(zeta, normals);
+
+    UVLM::Types::VecDimensions dimensions;
+    UVLM::Types::generate_dimensions(zeta_col, dimensions);
+    const UVLM::LinearSolver::SystemLayout layout =
+        UVLM::LinearSolver::generate_layout(dimensions);
+    uint Ktotal = 0;
+    for (uint i_surf=0; i_surf<dimensions.size(); ++i_surf)
+    {
+        Ktotal += dimensions[i_surf].first*dimensions[i_surf].second;
+    }
+
+    // collocation velocities and wake spacing of every case
+    std::vector<UVLM::Types::VecVecMatrixX> uext_col(n_cases);
+    std::vector<double> delta_x(n_cases);
+    for (uint i_case=0; i_case<n_cases; ++i_case)
+    {
+        UVLM::Geometry::generate_colocationMesh(uext[i_case], uext_col[i_case]);
+        UVLM::Types::Vector3 u_steady;
+        u_steady << uext[i_case][0][0](0,0),
+                    uext[i_case][0][1](0,0),
+                    uext[i_case][0][2](0,0);
+        delta_x[i_case] = u_steady.norm()*options.dt;
+    }
+
+    // groups of cases with the same wake geometry
+    std::vector<std::vector<uint>> groups;
+    for (uint i_case=0; i_case<n_cases; ++i_case)
+    {
+        bool found = false;
+        for (uint i_group=0; i_group<groups.size(); ++i_group)
+        {
+            const double reference = delta_x[groups[i_group][0]];
+            if (options.horseshoe ||
+                std::abs(delta_x[i_case] - reference) <=
+                    UVLM::Constants::EPSILON*std::max(1.0, std::abs(reference)))
+            {
+                groups[i_group].push_back(i_case);
+                found = true;
+                break;
+            }
+        }
+        if (!found) {groups.push_back(std::vector<uint>(1, i_case));}
+    }
+
+    for (uint i_group=0; i_group<groups.size(); ++i_group)
+    {
+        const std::vector<uint>& group = groups[i_group];
+        const uint n_group = group.size();
+
+        UVLM::Types::MatrixX rhs(Ktotal, n_group);
+        UVLM::Types::MatrixX gamma_flat(Ktotal, n_group);
+        for (uint i=0; i<n_group; ++i)
+        {
+            const uint i_case = group[i];
+            UVLM::Wake::Horseshoe::init(zeta,
+                                        zeta_star[i_case],
+                                        flightconditions);
+            if (!options.horseshoe)
+            {
+                UVLM::Wake::Horseshoe::to_discretised(zeta_star[i_case],
+                                                      gamma_star[i_case],
+                                                      delta_x[i_case]);
+            }
+
+            UVLM::Types::VectorX rhs_case;
+            UVLM::Matrix::RHS(zeta_col,
+                              zeta_star[i_case],
+                              uext_col[i_case],
+                              gamma_star[i_case],
+                              normals,
+                              options,
+                              rhs_case,
+                              Ktotal);
+            rhs.col(i) = rhs_case;
+
+            UVLM::Types::VectorX gamma_case;
+            UVLM::Matrix::deconstruct_gamma(gamma[i_case],
+                                            gamma_case,
+                                            zeta_col);
+            gamma_flat.col(i) = gamma_case;
+        }
+
+        // one AIC for the whole group
+        UVLM::Types::MatrixX aic = UVLM::Types::MatrixX::Zero(Ktotal, Ktotal);
+        UVLM::Matrix::AIC(Ktotal,
+                          zeta,
+                          zeta_col,
+                          zeta_star[group[0]],
+                          uext_col[group[0]],
+                          normals,
+                          options,
+                          options.horseshoe,
+                          aic);
+
+        UVLM::LinearSolver::solve_multiple_systems(aic,
+                                                   rhs,
+                                                   options,
+                                                   layout,
+                                                   gamma_flat);
+
+        for (uint i=0; i<n_group; ++i)
+        {
+            const uint i_case = group[i];
+            UVLM::Types::VectorX gamma_case = gamma_flat.col(i);
+            UVLM::Matrix::reconstruct_gamma(gamma_case,
+                                            gamma[i_case],
+                                            zeta_col);
+            if (options.horseshoe)
+            {
+                UVLM::Wake::Horseshoe::circulation_transfer(gamma[i_case],
+                                                            gamma_star[i_case]);
+            } else if (options.Steady)
+            {
+                UVLM::Wake::Horseshoe::circulation_transfer(gamma[i_case],
+                                                            gamma_star[i_case],
+                                                            -1);
+            }
+        }
+    }
+
+    // forces of every case
+    #pragma omp parallel for schedule(dynamic)
+    for (uint i_case=0; i_case<n_cases; ++i_case)
+    {
+        UVLM::PostProc::calculate_static_forces
+        (
+            zeta,
+            zeta_star[i_case],
+            gamma[i_case],
+            gamma_star[i_case],
+            uext[i_case],
+            forces[i_case],
+            options,
+            flightconditions
+        );
+        if (options.horseshoe)
+        {
+            UVLM::Wake::Horseshoe::to_discretised(zeta_star[i_case],
+                                                  gamma_star[i_case],
+                                                  delta_x[i_case]);
+        }
+    }
+}
@@ -0,0 +1,204 @@
+#pragma once
+
+#include "EigenInclude.h"
+#include "types.h"
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+// Dense LU factorisation with partial pivoting, blocked by column tiles
+// and parallelised with OpenMP tasks, so that the factorisation scales
+// with the number of threads independently of the BLAS library.
+// The tasks of every elimination step only depend on the column tiles
+// they read and write, so the factorisation of the next panel starts as
+// soon as its tile is updated (look-ahead) while the rest of the trailing
+// matrix is still being updated.
+namespace UVLM
+{
+    namespace TiledLU
+    {
+        // number of columns of a tile
+        const uint TILE_SIZE = 128;
+
+        class Factorisation
+        {
+        public:
+            template <typename t_a>
+            void compute
+            (
+                const t_a& a,
+                const uint tile_size = TILE_SIZE
+            );
+
+            template <typename t_b>
+            UVLM::Types::VectorX solve
+            (
+                const t_b& b
+            ) const;
+
+            // solution of several right-hand sides (columns of b)
+            template <typename t_b>
+            void solve_in_place
+            (
+                t_b& b
+            ) const;
+
+            uint rows() const {return lu.rows();}
+
+        private:
+            // L (unit lower) and U, column major for the panel operations
+            Eigen::MatrixXd lu;
+            // row i was swapped with row pivots[i] (in order)
+            std::vector<uint> pivots;
+
+            void factorise_panel
+            (
+                const uint first,
+                const uint last
+            );
+
+            void apply_swaps
+            (
+                const uint first,
+                const uint last,
+                const uint first_col,
+                const uint last_col
+            );
+        };
+    }
+}
+
+
+/*-----------------------------------------------------------------------------
+Unblocked LU with partial pivoting of the columns [first, last) from row
+first down. The row swaps are only applied to the panel columns.
+-----------------------------------------------------------------------------*/
+void UVLM::TiledLU::Factorisation::factorise_panel
+(
+    const uint first,
+    const uint last
+)
+{
+    const uint n = lu.rows();
+    for (uint c=first; c<last; ++c)
+    {
+        Eigen::Index pivot;
+        lu.col(c).tail(n - c).cwiseAbs().maxCoeff(&pivot);
+        pivots[c] = c + pivot;
+        if (pivots[c] != c)
+        {
+            lu.block(c, first, 1, last - first).swap(lu.block(pivots[c], first, 1, last - first));
+        }
+        if (lu(c, c) != 0.0)
+        {
+            lu.col(c).tail(n - c - 1) /= lu(c, c);
+        }
+        lu.block(c + 1, c + 1, n - c - 1, last - c - 1).noalias() -=
+            lu.col(c).tail(n - c - 1)*lu.row(c).segment(c + 1, last - c - 1);
+    }
+}
+
+
+// Row swaps of the panel [first, last) on the columns [first_col, last_col)
+void UVLM::TiledLU::Factorisation::apply_swaps
+(
+    const uint first,
+    const uint last,
+    const uint first_col,
+    const uint last_col
+)
+{
+    for (uint c=first; c<last; ++c)
+    {
+        if (pivots[c] != c)
+        {
+            lu.block(c, first_col, 1, last_col - first_col).swap(
+                lu.block(pivots[c], first_col, 1, last_col - first_col));
+        }
+    }
+}
+
+
+template <typename t_a>
+void UVLM::TiledLU::Factorisation::compute
+(
+    const t_a& a,
+    const uint tile_size
+)
+{
+    lu = a;
+    const uint n = lu.rows();
+    pivots.resize(n);
+    const uint n_tiles = (n + tile_size - 1)/tile_size;
+    // dependency tokens of the column tiles
+    std::vector<char> tile_token(n_tiles);
+    char* token = tile_token.data();
+
+    #pragma omp parallel
+    {
+        #pragma omp single
+        {
+            for (uint k=0; k<n_tiles; ++k)
+            {
+                const uint k_first = k*tile_size;
+                const uint k_last = std::min(n, k_first + tile_size);
+
+                #pragma omp task firstprivate(k_first, k_last) depend(inout: token[k])
+                factorise_panel(k_first, k_last);
+
+                for (uint j=0; j<n_tiles; ++j)
+                {
+                    if (j == k) {continue;}
+                    const uint j_first = j*tile_size;
+                    const uint j_last = std::min(n, j_first + tile_size);
+                    #pragma omp task firstprivate(j, k_first, k_last, j_first, j_last) depend(in: token[k]) depend(inout: token[j])
+                    {
+                        apply_swaps(k_first, k_last, j_first, j_last);
+                        if (j > k)
+                        {
+                            // row of U and update of the trailing tile
+                            lu.block(k_first, k_first, k_last - k_first, k_last - k_first)
+                                .triangularView<Eigen::UnitLower>()
+                                .solveInPlace(lu.block(k_first, j_first, k_last - k_first, j_last - j_first));
+                            lu.block(k_last, j_first, n - k_last, j_last - j_first).noalias() -=
+                                lu.block(k_last, k_first, n - k_last, k_last - k_first)*
+                                lu.block(k_first, j_first, k_last - k_first, j_last - j_first);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+template <typename t_b>
+UVLM::Types::VectorX UVLM::TiledLU::Factorisation::solve
+(
+    const t_b& b
+) const
+{
+    UVLM::Types::VectorX x = b;
+    solve_in_place(x);
+    return x;
+}
+
+
+template <typename t_b>
+void UVLM::TiledLU::Factorisation::solve_in_place
+(
+    t_b& b
+) const
+{
+    const uint n = lu.rows();
+    for (uint i=0; i<n; ++i)
+    {
+        if (pivots[i] != i)
+        {
+            b.row(i).swap(b.row(pivots[i]));
+        }
+    }
+    lu.triangularView<Eigen::UnitLower>().solveInPlace(b);
+    lu.triangularView<Eigen::Upper>().solveInPlace(b);
+}
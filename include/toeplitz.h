@@ -0,0 +1,440 @@
+#pragma once
+
+#include "EigenInclude.h"
+#include "types.h"
+#include "constants.h"
+#include "matrix.h"
+#include "krylov.h"
+#include <unsupported/Eigen/FFT>
+
+#include <complex>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+// Structured AIC of a single lattice with uniform spacing.
+// The influence of a bound vortex ring on a collocation point only depends
+// on the difference of their chordwise and spanwise indices, so the bound
+// AIC is two-level Toeplitz and is stored as its (2M-1)x(2N-1) generating
+// entries. The wake only adds to the trailing edge columns, and it is
+// Toeplitz in the spanwise index (M x (2N-1) generating entries).
+// The products are circular convolutions computed with FFTs, and the system
+// is solved with GMRES preconditioned with the two-level (Strang) circulant
+// approximation of the bound AIC: O(K log K) time and O(K) memory per
+// iteration instead of the K^2 of the dense AIC.
+namespace UVLM
+{
+    namespace Toeplitz
+    {
+        typedef std::complex<UVLM::Types::Real> Complex;
+        typedef Eigen::Matrix<Complex, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> MatrixXc;
+        typedef Eigen::Matrix<Complex, Eigen::Dynamic, 1> VectorXc;
+
+        template <typename t_zeta>
+        bool is_uniform_grid
+        (
+            const t_zeta& zeta,
+            const UVLM::Types::Vector3& chordwise,
+            const UVLM::Types::Vector3& spanwise,
+            const uint n_rows,
+            const UVLM::Types::Real tolerance
+        );
+
+        template <typename t_zeta,
+                  typename t_zeta_star>
+        bool is_uniform
+        (
+            const t_zeta& zeta,
+            const t_zeta_star& zeta_star,
+            const UVLM::Types::VMopts& options,
+            const bool horseshoe
+        );
+
+        void fft2
+        (
+            MatrixXc& data,
+            const bool inverse
+        );
+
+        class ToeplitzAIC
+        {
+        public:
+            template <typename t_entries>
+            void assemble
+            (
+                const t_entries& bound,
+                const t_entries& full,
+                const uint in_M,
+                const uint in_N,
+                const bool in_with_wake
+            );
+
+            // out = AIC*in
+            void operator()
+            (
+                const UVLM::Types::VectorX& in,
+                UVLM::Types::VectorX& out
+            ) const;
+
+            // out = C^{-1}*in, C circulant approximation of the bound AIC
+            void precondition
+            (
+                const UVLM::Types::VectorX& in,
+                UVLM::Types::VectorX& out
+            ) const;
+
+        private:
+            uint M;
+            uint N;
+            // size of the circular embedding
+            uint Lm;
+            uint Ln;
+            bool with_wake;
+            // FFT of the embedded generating entries
+            MatrixXc bound_symbol;
+            MatrixXc wake_symbol;
+            // eigenvalues of the circulant preconditioner
+            MatrixXc circulant_symbol;
+        };
+
+        struct CirculantPreconditioner
+        {
+            const ToeplitzAIC& aic;
+
+            void operator()
+            (
+                const UVLM::Types::VectorX& in,
+                UVLM::Types::VectorX& out
+            ) const
+            {
+                aic.precondition(in, out);
+            }
+        };
+
+        template <typename t_zeta,
+                  typename t_zeta_col,
+                  typename t_zeta_star,
+                  typename t_normals>
+        bool solve
+        (
+            const t_zeta& zeta,
+            const t_zeta_col& zeta_col,
+            const t_zeta_star& zeta_star,
+            const t_normals& normals,
+            const UVLM::Types::VMopts& options,
+            const bool horseshoe,
+            const UVLM::Types::VectorX& rhs,
+            UVLM::Types::VectorX& x
+        );
+    }
+}
+
+
+// The first n_rows rows of zeta are zeta(0, 0) + i*chordwise + j*spanwise
+template <typename t_zeta>
+bool UVLM::Toeplitz::is_uniform_grid
+(
+    const t_zeta& zeta,
+    const UVLM::Types::Vector3& chordwise,
+    const UVLM::Types::Vector3& spanwise,
+    const uint n_rows,
+    const UVLM::Types::Real tolerance
+)
+{
+    const uint n_cols = zeta[0].cols();
+    for (uint i=0; i<n_rows; ++i)
+    {
+        for (uint j=0; j<n_cols; ++j)
+        {
+            for (uint i_dim=0; i_dim<UVLM::Constants::NDIM; ++i_dim)
+            {
+                const UVLM::Types::Real expected = zeta[i_dim](0, 0) +
+                                                   i*chordwise(i_dim) +
+                                                   j*spanwise(i_dim);
+                if (std::abs(zeta[i_dim](i, j) - expected) > tolerance)
+                {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+
+template <typename t_zeta,
+          typename t_zeta_star>
+bool UVLM::Toeplitz::is_uniform
+(
+    const t_zeta& zeta,
+    const t_zeta_star& zeta_star,
+    const UVLM::Types::VMopts& options,
+    const bool horseshoe
+)
+{
+    if (options.NumSurfaces != 1) {return false;}
+    // the mirror images are not translation invariant
+    if (!UVLM::Types::mirror_images(options).empty()) {return false;}
+
+    const uint M = zeta[0][0].rows() - 1;
+    const uint N = zeta[0][0].cols() - 1;
+    UVLM::Types::Vector3 chordwise;
+    UVLM::Types::Vector3 spanwise;
+    UVLM::Types::Vector3 diagonal;
+    for (uint i_dim=0; i_dim<UVLM::Constants::NDIM; ++i_dim)
+    {
+        chordwise(i_dim) = zeta[0][i_dim](1, 0) - zeta[0][i_dim](0, 0);
+        spanwise(i_dim) = zeta[0][i_dim](0, 1) - zeta[0][i_dim](0, 0);
+        diagonal(i_dim) = zeta[0][i_dim](M, N) - zeta[0][i_dim](0, 0);
+    }
+    const UVLM::Types::Real tolerance = UVLM::Constants::POSE_TOLERANCE*diagonal.norm();
+    if (!is_uniform_grid(zeta[0], chordwise, spanwise, M + 1, tolerance))
+    {
+        return false;
+    }
+
+    if (options.Steady)
+    {
+        // the wake has to keep the spanwise spacing of the lattice
+        const uint n_rows = horseshoe ? 2 : zeta_star[0][0].rows();
+        for (uint i=0; i<n_rows; ++i)
+        {
+            for (uint j=0; j<=N; ++j)
+            {
+                for (uint i_dim=0; i_dim<UVLM::Constants::NDIM; ++i_dim)
+                {
+                    const UVLM::Types::Real expected = zeta_star[0][i_dim](i, 0) +
+                                                       j*spanwise(i_dim);
+                    if (std::abs(zeta_star[0][i_dim](i, j) - expected) > tolerance)
+                    {
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+
+// 2D FFT (by rows and columns); the inverse is scaled
+void UVLM::Toeplitz::fft2
+(
+    MatrixXc& data,
+    const bool inverse
+)
+{
+    Eigen::FFT<UVLM::Types::Real> fft;
+    VectorXc in;
+    VectorXc out;
+    for (uint i=0; i<data.rows(); ++i)
+    {
+        in = data.row(i).transpose();
+        if (inverse) {fft.inv(out, in);} else {fft.fwd(out, in);}
+        data.row(i) = out.transpose();
+    }
+    for (uint j=0; j<data.cols(); ++j)
+    {
+        in = data.col(j);
+        if (inverse) {fft.inv(out, in);} else {fft.fwd(out, in);}
+        data.col(j) = out;
+    }
+}
+
+
+/*-----------------------------------------------------------------------------
+bound: entries of the AIC without wake, full: entries with the wake.
+The entry of the collocation point (i_col, j_col) and the panel (i, j) is
+T(i_col - i, j_col - j) (+ W(i_col, j_col - j) if i is the trailing edge).
+-----------------------------------------------------------------------------*/
+template <typename t_entries>
+void UVLM::Toeplitz::ToeplitzAIC::assemble
+(
+    const t_entries& bound,
+    const t_entries& full,
+    const uint in_M,
+    const uint in_N,
+    const bool in_with_wake
+)
+{
+    M = in_M;
+    N = in_N;
+    Lm = 2*M;
+    Ln = 2*N;
+    with_wake = in_with_wake;
+
+    bound_symbol = MatrixXc::Zero(Lm, Ln);
+    circulant_symbol = MatrixXc::Zero(M, N);
+    for (int di=-int(M)+1; di<int(M); ++di)
+    {
+        for (int dj=-int(N)+1; dj<int(N); ++dj)
+        {
+            const uint row = std::max(di, 0)*N + std::max(dj, 0);
+            const uint col = std::max(-di, 0)*N + std::max(-dj, 0);
+            const UVLM::Types::Real entry = bound(row, col);
+            bound_symbol((di + Lm)%Lm, (dj + Ln)%Ln) = entry;
+            // Strang: the central diagonals wrapped around
+            if ((di >= 0 ? 2*di <= int(M) : -2*di < int(M)) &&
+                (dj >= 0 ? 2*dj <= int(N) : -2*dj < int(N)))
+            {
+                circulant_symbol((di + M)%M, (dj + N)%N) = entry;
+            }
+        }
+    }
+    fft2(bound_symbol, false);
+    fft2(circulant_symbol, false);
+
+    if (with_wake)
+    {
+        wake_symbol = MatrixXc::Zero(M, Ln);
+        #pragma omp parallel for
+        for (uint i=0; i<M; ++i)
+        {
+            for (int dj=-int(N)+1; dj<int(N); ++dj)
+            {
+                const uint row = i*N + std::max(dj, 0);
+                const uint col = (M - 1)*N + std::max(-dj, 0);
+                wake_symbol(i, (dj + Ln)%Ln) = full(row, col) - bound(row, col);
+            }
+        }
+        Eigen::FFT<UVLM::Types::Real> fft;
+        VectorXc in;
+        VectorXc out;
+        for (uint i=0; i<M; ++i)
+        {
+            in = wake_symbol.row(i).transpose();
+            fft.fwd(out, in);
+            wake_symbol.row(i) = out.transpose();
+        }
+    }
+}
+
+
+void UVLM::Toeplitz::ToeplitzAIC::operator()
+(
+    const UVLM::Types::VectorX& in,
+    UVLM::Types::VectorX& out
+) const
+{
+    MatrixXc padded = MatrixXc::Zero(Lm, Ln);
+    for (uint i=0; i<M; ++i)
+    {
+        for (uint j=0; j<N; ++j)
+        {
+            padded(i, j) = in(i*N + j);
+        }
+    }
+    fft2(padded, false);
+    padded = padded.cwiseProduct(bound_symbol);
+    fft2(padded, true);
+
+    out.resize(M*N);
+    for (uint i=0; i<M; ++i)
+    {
+        for (uint j=0; j<N; ++j)
+        {
+            out(i*N + j) = padded(i, j).real();
+        }
+    }
+
+    if (with_wake)
+    {
+        Eigen::FFT<UVLM::Types::Real> fft;
+        VectorXc trailing_edge = VectorXc::Zero(Ln);
+        for (uint j=0; j<N; ++j)
+        {
+            trailing_edge(j) = in((M - 1)*N + j);
+        }
+        VectorXc te_symbol;
+        fft.fwd(te_symbol, trailing_edge);
+        VectorXc product;
+        VectorXc convolution;
+        for (uint i=0; i<M; ++i)
+        {
+            product = wake_symbol.row(i).transpose().cwiseProduct(te_symbol);
+            fft.inv(convolution, product);
+            for (uint j=0; j<N; ++j)
+            {
+                out(i*N + j) += convolution(j).real();
+            }
+        }
+    }
+}
+
+
+void UVLM::Toeplitz::ToeplitzAIC::precondition
+(
+    const UVLM::Types::VectorX& in,
+    UVLM::Types::VectorX& out
+) const
+{
+    MatrixXc data(M, N);
+    for (uint i=0; i<M; ++i)
+    {
+        for (uint j=0; j<N; ++j)
+        {
+            data(i, j) = in(i*N + j);
+        }
+    }
+    fft2(data, false);
+    data = data.cwiseQuotient(circulant_symbol);
+    fft2(data, true);
+    out.resize(M*N);
+    for (uint i=0; i<M; ++i)
+    {
+        for (uint j=0; j<N; ++j)
+        {
+            out(i*N + j) = data(i, j).real();
+        }
+    }
+}
+
+
+/*-----------------------------------------------------------------------------
+Solution of the system of a uniform lattice with the structured AIC.
+Returns false (and x is not modified) if the lattice is not uniform.
+-----------------------------------------------------------------------------*/
+template <typename t_zeta,
+          typename t_zeta_col,
+          typename t_zeta_star,
+          typename t_normals>
+bool UVLM::Toeplitz::solve
+(
+    const t_zeta& zeta,
+    const t_zeta_col& zeta_col,
+    const t_zeta_star& zeta_star,
+    const t_normals& normals,
+    const UVLM::Types::VMopts& options,
+    const bool horseshoe,
+    const UVLM::Types::VectorX& rhs,
+    UVLM::Types::VectorX& x
+)
+{
+    if (!is_uniform(zeta, zeta_star, options, horseshoe))
+    {
+        return false;
+    }
+
+    UVLM::Types::VMopts bound_options = options;
+    bound_options.Steady = false;
+    const UVLM::Matrix::AICEntries<t_zeta, t_zeta_col, t_zeta_star, t_normals>
+        bound(zeta, zeta_col, zeta_star, normals, bound_options, horseshoe);
+    const UVLM::Matrix::AICEntries<t_zeta, t_zeta_col, t_zeta_star, t_normals>
+        full(zeta, zeta_col, zeta_star, normals, options, horseshoe);
+
+    ToeplitzAIC aic;
+    aic.assemble(bound,
+                 full,
+                 zeta_col[0][0].rows(),
+                 zeta_col[0][0].cols(),
+                 options.Steady);
+
+    const CirculantPreconditioner preconditioner = {aic};
+    UVLM::Krylov::gmres(aic,
+                        preconditioner,
+                        rhs,
+                        x,
+                        (options.iterative_tol > 0.0) ? options.iterative_tol :
+                                                        UVLM::Krylov::DEFAULT_TOLERANCE);
+    return true;
+}
@@ -30,6 +30,12 @@ namespace UVLM
         typedef Eigen::DenseBase<Real> DenseBase;
         typedef Eigen::Block<MatrixX> Block;
 
+        typedef Eigen::Matrix<Real, 3, 3> Matrix3;
+
+        // Single precision, for mixed precision factorisations
+        typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> MatrixXf;
+        typedef Eigen::Matrix<float, Eigen::Dynamic, 1> VectorXf;
+
         // Vectors
         typedef Eigen::Matrix<Real, 3, 1> Vector3;
         typedef Eigen::Matrix<Real, 6, 1> Vector6;
@@ -43,6 +49,7 @@ namespace UVLM
 
         struct VMopts
         {
+        	// ground effect: mirror images on the plane z = 0
         	bool ImageMethod;
         	// unsigned int Mstar;
         	bool Steady;
@@ -60,6 +67,46 @@ namespace UVLM
             bool iterative_solver;
             double iterative_tol;
             bool iterative_precond;
+            bool aic_cache;
+            bool lowrank_update;
+            bool hmatrix;
+            double hmatrix_tol;
+            // preconditioner of the iterative solver (if iterative_precond):
+            // 0: block-Jacobi, 1: ILUT, 2: near field SPAI,
+            // 3: LU of a previous AIC, 4: two-grid (2x2 coarsened lattice)
+            uint iterative_precond_type;
+            // iterations above which the previous LU is refactorised
+            uint stale_lu_iterations;
+            // order of the polynomial extrapolation of the previous
+            // solutions used as initial guess by the iterative solver
+            // (0: previous solution, 1: linear, 2: quadratic)
+            uint gamma_extrapolation;
+            bool mixed_precision;
+            // GCRO-DR with a Krylov space recycled between solutions
+            // as iterative solver
+            bool krylov_recycling;
+            // direct solver by surface blocks:
+            // 0: none, 1: block LU (Schur complement), 2: block Gauss-Seidel
+            uint block_solver;
+            // task-parallel tiled LU for the direct solver
+            bool tiled_lu;
+            // initial guess of the iterative solver from the solution on
+            // the lattice coarsened by merging 2x2 panels
+            bool coarse_guess;
+            // FFT-based iterative solver for single uniform lattices
+            // (two-level Toeplitz AIC)
+            bool toeplitz;
+            // half model: the lattice is mirrored on the symmetry plane
+            // (through the origin, normal to the axis symmetry_plane:
+            // 0 x, 1 y, 2 z). Forces are those of the meshed half.
+            bool symmetry_condition;
+            uint symmetry_plane;
+            // evaluate the induced velocities of the segment tables with
+            // targets and segments sorted along a Morton curve
+            bool morton_order;
+            // wake convection velocities evaluated in single precision
+            // (accumulated in double)
+            bool single_precision_convection;
         };
 
         struct UVMopts
@@ -72,11 +119,52 @@ namespace UVLM
             // uint steady_rollup_aic_refresh;
             uint convection_scheme;
             // uint Mstar;
+            // ground effect: mirror images on the plane z = 0
             bool ImageMethod;
             bool iterative_solver;
             double iterative_tol;
             bool iterative_precond;
             bool convect_wake;
+            bool aic_cache;
+            bool lowrank_update;
+            bool hmatrix;
+            double hmatrix_tol;
+            // preconditioner of the iterative solver (if iterative_precond):
+            // 0: block-Jacobi, 1: ILUT, 2: near field SPAI,
+            // 3: LU of a previous AIC, 4: two-grid (2x2 coarsened lattice)
+            uint iterative_precond_type;
+            // iterations above which the previous LU is refactorised
+            uint stale_lu_iterations;
+            // order of the polynomial extrapolation of the previous
+            // solutions used as initial guess by the iterative solver
+            // (0: previous solution, 1: linear, 2: quadratic)
+            uint gamma_extrapolation;
+            bool mixed_precision;
+            // GCRO-DR with a Krylov space recycled between solutions
+            // as iterative solver
+            bool krylov_recycling;
+            // direct solver by surface blocks:
+            // 0: none, 1: block LU (Schur complement), 2: block Gauss-Seidel
+            uint block_solver;
+            // task-parallel tiled LU for the direct solver
+            bool tiled_lu;
+            // initial guess of the iterative solver from the solution on
+            // the lattice coarsened by merging 2x2 panels
+            bool coarse_guess;
+            // FFT-based iterative solver for single uniform lattices
+            // (two-level Toeplitz AIC)
+            bool toeplitz;
+            // half model: the lattice is mirrored on the symmetry plane
+            // (through the origin, normal to the axis symmetry_plane:
+            // 0 x, 1 y, 2 z). Forces are those of the meshed half.
+            bool symmetry_condition;
+            uint symmetry_plane;
+            // evaluate the induced velocities of the segment tables with
+            // targets and segments sorted along a Morton curve
+            bool morton_order;
+            // wake convection velocities evaluated in single precision
+            // (accumulated in double)
+            bool single_precision_convection;
         };
 
         VMopts UVMopts2VMopts(const UVMopts& uvm)
@@ -90,12 +178,93 @@ namespace UVLM
             vm.iterative_solver = uvm.iterative_solver;
             vm.iterative_tol = uvm.iterative_tol;
             vm.iterative_precond = uvm.iterative_precond;
+            vm.aic_cache = uvm.aic_cache;
+            vm.lowrank_update = uvm.lowrank_update;
+            vm.hmatrix = uvm.hmatrix;
+            vm.hmatrix_tol = uvm.hmatrix_tol;
+            vm.iterative_precond_type = uvm.iterative_precond_type;
+            vm.stale_lu_iterations = uvm.stale_lu_iterations;
+            vm.gamma_extrapolation = uvm.gamma_extrapolation;
+            vm.mixed_precision = uvm.mixed_precision;
+            vm.krylov_recycling = uvm.krylov_recycling;
+            vm.block_solver = uvm.block_solver;
+            vm.tiled_lu = uvm.tiled_lu;
+            vm.coarse_guess = uvm.coarse_guess;
+            vm.toeplitz = uvm.toeplitz;
+            vm.symmetry_condition = uvm.symmetry_condition;
+            vm.symmetry_plane = uvm.symmetry_plane;
+            vm.morton_order = uvm.morton_order;
+            vm.single_precision_convection = uvm.single_precision_convection;
             vm.horseshoe = false;
             vm.Steady = false;
 
             return vm;
         };
 
+        // Mirror images of the lattice on planes through the origin.
+        // The image of a vortex segment on S = diag(sign) (a reflection or
+        // the product of two) induces S*u(S*x) at x, u being the velocity
+        // induced by the segment itself, so the images are evaluated with
+        // the segments of the actual lattice at the reflected targets.
+        struct MirrorImages
+        {
+            uint n_images = 0;
+            Vector3 sign[3];
+
+            bool empty() const {return n_images == 0;}
+
+            template <typename t_vector>
+            Vector3 reflect(const uint i_image, const t_vector& v) const
+            {
+                return sign[i_image].cwiseProduct(Vector3(v));
+            }
+        };
+
+        template <typename t_options>
+        inline MirrorImages mirror_images(const t_options& options)
+        {
+            MirrorImages images;
+            if (options.symmetry_condition && options.symmetry_plane < 3)
+            {
+                images.sign[0].setOnes();
+                images.sign[0](options.symmetry_plane) = -1.0;
+                images.n_images = 1;
+            }
+            if (options.ImageMethod &&
+                !(options.symmetry_condition && options.symmetry_plane == 2))
+            {
+                // ground plane z = 0, for the lattice and for its images
+                const uint n_images = images.n_images;
+                images.sign[images.n_images].setOnes();
+                images.sign[images.n_images](2) = -1.0;
+                ++images.n_images;
+                for (uint i_image=0; i_image<n_images; ++i_image)
+                {
+                    images.sign[images.n_images] = images.sign[i_image];
+                    images.sign[images.n_images](2) = -1.0;
+                    ++images.n_images;
+                }
+            }
+            return images;
+        }
+
+        // Statistics of the linear solver session
+        struct SolverStatistics
+        {
+            unsigned int n_solves = 0;
+            unsigned int n_factorisations = 0;
+            unsigned int n_updates = 0;
+            // mixed precision or block Gauss-Seidel solves that had to
+            // fall back to a full double precision LU
+            unsigned int n_fallbacks = 0;
+            // iterative solver
+            unsigned int last_iterations = 0;
+            unsigned int total_iterations = 0;
+            // relative residuals of the initial guess and the solution
+            double guess_residual = 0.0;
+            double last_residual = 0.0;
+        };
+
         struct FlightConditions
         {
             double uinf = 1.0;
@@ -110,6 +279,9 @@ namespace UVLM
             double rot_center[3];
             double rot_vel;
             double rot_axis[3];
+            // identical blades (one surface each) equally spaced around
+            // rot_axis are solved per Fourier mode of the blade index
+            bool cyclic_symmetry = false;
         };
 
         template <typename t_mat>
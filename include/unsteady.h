@@ -11,8 +11,10 @@
 #include "postproc.h"
 #include "steady.h"
 #include "wake.h"
+#include "cyclic_symmetry.h"
 
 #include <iostream>
+#include <vector>
 
 // DECLARATIONS
 namespace UVLM
@@ -49,6 +51,34 @@ namespace UVLM
             const UVLM::Types::FlightConditions& flightconditions
         );
 
+        template <typename t_zeta,
+                  typename t_zeta_dot,
+                  typename t_uext,
+                  typename t_uext_star,
+                  typename t_zeta_star,
+                  typename t_gamma,
+                  typename t_gamma_star,
+                  typename t_normals,
+                  typename t_rbm_velocity,
+                  typename t_forces>
+        void ensemble_solver
+        (
+            const uint& i_iter,
+            t_zeta& zeta,
+            t_zeta_dot& zeta_dot,
+            t_uext& uext,
+            t_uext_star& uext_star,
+            t_zeta_star& zeta_star,
+            t_gamma& gamma,
+            t_gamma_star& gamma_star,
+            t_normals& normals,
+            t_rbm_velocity& rbm_velocity,
+            t_forces& forces,
+            t_forces& dynamic_forces,
+            const UVLM::Types::UVMopts& options,
+            const UVLM::Types::FlightConditions& flightconditions
+        );
+
         template <typename t_zeta,
                   typename t_zeta_dot,
                   typename t_zeta_star,
@@ -398,18 +428,38 @@ void UVLM::Unsteady::shw_solver
                                     flightconditions,
                                     shwoptions);
 
-    UVLM::Steady::solve_discretised
-    (
-        zeta,
-        zeta_col,
-        uext_total_col,
-        zeta_star,
-        gamma,
-        gamma_star,
-        normals,
-        steady_options,
-        flightconditions
-    );
+    bool cyclic = false;
+    if (shwoptions.cyclic_symmetry)
+    {
+        // per Fourier mode of the blade index, if the rotor is cyclic
+        cyclic = UVLM::CyclicSymmetry::solve_discretised
+        (
+            zeta,
+            zeta_col,
+            uext_total_col,
+            zeta_star,
+            gamma,
+            gamma_star,
+            normals,
+            steady_options,
+            shwoptions
+        );
+    }
+    if (!cyclic)
+    {
+        UVLM::Steady::solve_discretised
+        (
+            zeta,
+            zeta_col,
+            uext_total_col,
+            zeta_star,
+            gamma,
+            gamma_star,
+            normals,
+            steady_options,
+            flightconditions
+        );
+    }
 
     // END
 
@@ -456,3 +506,207 @@ void UVLM::Unsteady::shw_solver
         // std::cout << dynamic_forces[0][2].maxCoeff() << std::endl;
     // }
 }
+
+
+/*-----------------------------------------------------------------------------
+Time step of an ensemble of cases (gust and turbulence sweeps) that share the
+lattice motion and the prescribed wake (convection_scheme == 0) and only differ
+in uext, uext_star and the circulation. uext, uext_star, zeta_star, gamma,
+gamma_star, forces and dynamic_forces hold one entry per case; zeta_star of
+the first case is used as the common wake geometry.
+The AIC and the wake normal wash are assembled once per step, so the wake
+contribution to the RHS and the induced velocities of the forces of all the
+cases are matrix products, and all the RHS are solved together.
+Other convection schemes convect a different wake for every case, and the
+H-matrix and Toeplitz solvers do not assemble the AIC: they fall back to
+UVLM::Unsteady::solver case by case.
+-----------------------------------------------------------------------------*/
+template <typename t_zeta,
+          typename t_zeta_dot,
+          typename t_uext,
+          typename t_uext_star,
+          typename t_zeta_star,
+          typename t_gamma,
+          typename t_gamma_star,
+          typename t_normals,
+          typename t_rbm_velocity,
+          typename t_forces>
+void UVLM::Unsteady::ensemble_solver
+(
+    const uint& i_iter,
+    t_zeta& zeta,
+    t_zeta_dot& zeta_dot,
+    t_uext& uext,
+    t_uext_star& uext_star,
+    t_zeta_star& zeta_star,
+    t_gamma& gamma,
+    t_gamma_star& gamma_star,
+    t_normals& normals,
+    t_rbm_velocity& rbm_velocity,
+    t_forces& forces,
+    t_forces& dynamic_forces,
+    const UVLM::Types::UVMopts& options,
+    const UVLM::Types::FlightConditions& flightconditions
+)
+{
+    const uint n_cases = uext.size();
+    if (n_cases == 0) {return;}
+
+    if (options.convection_scheme != 0 || options.hmatrix || options.toeplitz)
+    {
+        for (uint i_case=0; i_case<n_cases; ++i_case)
+        {
+            UVLM::Unsteady::solver(i_iter,
+                                   zeta,
+                                   zeta_dot,
+                                   uext[i_case],
+                                   uext_star[i_case],
+                                   zeta_star[i_case],
+                                   gamma[i_case],
+                                   gamma_star[i_case],
+                                   normals,
+                                   rbm_velocity,
+                                   forces[i_case],
+                                   dynamic_forces[i_case],
+                                   options,
+                                   flightconditions);
+        }
+        return;
+    }
+
+    const UVLM::Types::VMopts steady_options = UVLM::Types::UVMopts2VMopts(options);
+
+    UVLM::Types::VecVecMatrixX zeta_col;
+    UVLM::Geometry::generate_colocationMesh(zeta, zeta_col);
+    UVLM::Geometry::generate_surfaceNormal(zeta, normals);
+
+    UVLM::Types::VecDimensions dimensions;
+    UVLM::Types::generate_dimensions(zeta_col, dimensions);
+    const UVLM::LinearSolver::SystemLayout layout =
+        UVLM::LinearSolver::generate_layout(dimensions);
+    const std::vector<uint> offset = UVLM::Matrix::surface_offsets(dimensions);
+    UVLM::Types::VecDimensions dimensions_star;
+    UVLM::Types::generate_dimensions(zeta_star[0], dimensions_star, -1);
+    const std::vector<uint> offset_star = UVLM::Matrix::surface_offsets(dimensions_star);
+    uint Ktotal = 0;
+    uint Kstar_total = 0;
+    for (uint i_surf=0; i_surf<dimensions.size(); ++i_surf)
+    {
+        Ktotal += dimensions[i_surf].first*dimensions[i_surf].second;
+        Kstar_total += dimensions_star[i_surf].first*dimensions_star[i_surf].second;
+    }
+
+    // free stream and wake circulation of every case
+    UVLM::Types::MatrixX rhs(Ktotal, n_cases);
+    UVLM::Types::MatrixX gamma_flat(Ktotal, n_cases);
+    UVLM::Types::MatrixX gamma_star_flat(Kstar_total, n_cases);
+    for (uint i_case=0; i_case<n_cases; ++i_case)
+    {
+        UVLM::Types::VecVecMatrixX uext_total;
+        UVLM::Types::allocate_VecVecMat(uext_total, uext[i_case]);
+        UVLM::Unsteady::Utils::compute_resultant_grid_velocity
+        (
+            zeta,
+            zeta_dot,
+            uext[i_case],
+            rbm_velocity,
+            uext_total
+        );
+        UVLM::Types::VecVecMatrixX uext_total_col;
+        UVLM::Geometry::generate_colocationMesh(uext_total, uext_total_col);
+
+        if (options.convect_wake)
+        {
+            // prescribed and fixed wake
+            UVLM::Wake::General::displace_VecMat(gamma_star[i_case]);
+        }
+        UVLM::Wake::Horseshoe::circulation_transfer(gamma[i_case],
+                                                   gamma_star[i_case],
+                                                   1);
+
+        for (uint i_surf=0; i_surf<dimensions.size(); ++i_surf)
+        {
+            const uint M = dimensions[i_surf].first;
+            const uint N = dimensions[i_surf].second;
+            for (uint i=0; i<M; ++i)
+            {
+                for (uint j=0; j<N; ++j)
+                {
+                    rhs(offset[i_surf] + i*N + j, i_case) =
+                    -(
+                        uext_total_col[i_surf][0](i, j)*normals[i_surf][0](i, j) +
+                        uext_total_col[i_surf][1](i, j)*normals[i_surf][1](i, j) +
+                        uext_total_col[i_surf][2](i, j)*normals[i_surf][2](i, j)
+                    );
+                    gamma_flat(offset[i_surf] + i*N + j, i_case) = gamma[i_case][i_surf](i, j);
+                }
+            }
+            const uint M_star = dimensions_star[i_surf].first;
+            for (uint i=0; i<M_star; ++i)
+            {
+                for (uint j=0; j<N; ++j)
+                {
+                    gamma_star_flat(offset_star[i_surf] + i*N + j, i_case) = gamma_star[i_case][i_surf](i, j);
+                }
+            }
+        }
+    }
+
+    // wake contribution of all the cases
+    UVLM::Types::MatrixX wash;
+    UVLM::Matrix::wake_normal_wash(zeta_col,
+                                   zeta_star[0],
+                                   normals,
+                                   wash,
+                                   UVLM::Types::mirror_images(options));
+    rhs.noalias() -= wash*gamma_star_flat;
+
+    UVLM::Types::MatrixX aic = UVLM::Types::MatrixX::Zero(Ktotal, Ktotal);
+    UVLM::Matrix::AIC(Ktotal,
+                      zeta,
+                      zeta_col,
+                      zeta_star[0],
+                      zeta_col,
+                      normals,
+                      steady_options,
+                      false,
+                      aic);
+    UVLM::LinearSolver::solve_multiple_systems(aic,
+                                               rhs,
+                                               steady_options,
+                                               layout,
+                                               gamma_flat);
+
+    for (uint i_case=0; i_case<n_cases; ++i_case)
+    {
+        UVLM::Types::VectorX gamma_case = gamma_flat.col(i_case);
+        UVLM::Matrix::reconstruct_gamma(gamma_case,
+                                        gamma[i_case],
+                                        zeta_col);
+    }
+
+    // forces calculation
+    std::vector<UVLM::Types::VecVecMatrixX> span_v_ind;
+    std::vector<UVLM::Types::VecVecMatrixX> chord_v_ind;
+    UVLM::PostProc::segment_induced_velocities_ensemble(zeta,
+                                                        zeta_star[0],
+                                                        gamma,
+                                                        gamma_star,
+                                                        span_v_ind,
+                                                        chord_v_ind,
+                                                        UVLM::Types::mirror_images(options));
+    #pragma omp parallel for schedule(dynamic)
+    for (uint i_case=0; i_case<n_cases; ++i_case)
+    {
+        UVLM::PostProc::static_forces_from_induced_velocities(zeta,
+                                                              zeta_dot,
+                                                              gamma[i_case],
+                                                              uext[i_case],
+                                                              rbm_velocity,
+                                                              span_v_ind[i_case],
+                                                              chord_v_ind[i_case],
+                                                              forces[i_case],
+                                                              flightconditions);
+        UVLM::Types::initialise_VecVecMat(dynamic_forces[i_case]);
+    }
+}
@@ -192,7 +192,10 @@ void UVLM::Unsteady::Utils::convect_unsteady_wake
             zeta_star,
             gamma,
             gamma_star,
-            u_convection
+            u_convection,
+            UVLM::Types::mirror_images(options),
+            options.morton_order,
+            options.single_precision_convection
         );
         // remove first row of convection velocities
         for (uint i_surf=0; i_surf<n_surf; ++i_surf)
@@ -85,6 +85,82 @@ DLLEXPORT void run_VLM
 }
 
 
+// Steady solution of n_cases flow fields on the same lattice.
+// The per-case arrays are indexed as p_u_ext[i_case][i_surf*NDIM + i_dim].
+DLLEXPORT void run_VLM_batch
+(
+    const UVLM::Types::VMopts& options,
+    const UVLM::Types::FlightConditions& flightconditions,
+    const unsigned int n_cases,
+    unsigned int** p_dimensions,
+    unsigned int** p_dimensions_star,
+    double** p_zeta,
+    double*** p_zeta_star,
+    double*** p_u_ext,
+    double*** p_gamma,
+    double*** p_gamma_star,
+    double*** p_forces
+)
+{
+    omp_set_num_threads(options.NumCores);
+    unsigned int n_surf;
+    n_surf = options.NumSurfaces;
+    UVLM::Types::VecDimensions dimensions;
+    UVLM::CppInterface::transform_dimensions(n_surf,
+                                             p_dimensions,
+                                             dimensions);
+    UVLM::Types::VecDimensions dimensions_star;
+    UVLM::CppInterface::transform_dimensions(n_surf,
+                                             p_dimensions_star,
+                                             dimensions_star);
+
+    UVLM::Types::VecVecMapX zeta;
+    UVLM::CppInterface::map_VecVecMat(dimensions,
+                                      p_zeta,
+                                      zeta,
+                                      1);
+
+    std::vector<UVLM::Types::VecVecMapX> zeta_star(n_cases);
+    std::vector<UVLM::Types::VecVecMapX> u_ext(n_cases);
+    std::vector<UVLM::Types::VecMapX> gamma(n_cases);
+    std::vector<UVLM::Types::VecMapX> gamma_star(n_cases);
+    std::vector<UVLM::Types::VecVecMapX> forces(n_cases);
+    for (uint i_case=0; i_case<n_cases; ++i_case)
+    {
+        UVLM::CppInterface::map_VecVecMat(dimensions_star,
+                                          p_zeta_star[i_case],
+                                          zeta_star[i_case],
+                                          1);
+        UVLM::CppInterface::map_VecVecMat(dimensions,
+                                          p_u_ext[i_case],
+                                          u_ext[i_case],
+                                          1);
+        UVLM::CppInterface::map_VecMat(dimensions,
+                                       p_gamma[i_case],
+                                       gamma[i_case],
+                                       0);
+        UVLM::CppInterface::map_VecMat(dimensions_star,
+                                       p_gamma_star[i_case],
+                                       gamma_star[i_case],
+                                       0);
+        UVLM::CppInterface::map_VecVecMat(dimensions,
+                                          p_forces[i_case],
+                                          forces[i_case],
+                                          1,
+                                          2*UVLM::Constants::NDIM);
+    }
+
+    UVLM::Steady::solver_batch(zeta,
+                               u_ext,
+                               zeta_star,
+                               gamma,
+                               gamma_star,
+                               forces,
+                               options,
+                               flightconditions);
+}
+
+
 DLLEXPORT void init_UVLM
 (
     const UVLM::Types::VMopts& options,
@@ -307,6 +383,121 @@ DLLEXPORT void run_UVLM
     );
 }
 
+// Time step of n_cases unsteady runs sharing the lattice motion.
+// The per-case arrays are indexed as p_uext[i_case][i_surf*NDIM + i_dim].
+DLLEXPORT void run_UVLM_ensemble
+(
+    const UVLM::Types::UVMopts& options,
+    const UVLM::Types::FlightConditions& flightconditions,
+    unsigned int** p_dimensions,
+    unsigned int** p_dimensions_star,
+    unsigned int i_iter,
+    const unsigned int n_cases,
+    double*** p_uext,
+    double*** p_uext_star,
+    double** p_zeta,
+    double*** p_zeta_star,
+    double** p_zeta_dot,
+    double*  p_rbm_vel,
+    double*** p_gamma,
+    double*** p_gamma_star,
+    double** p_normals,
+    double*** p_forces,
+    double*** p_dynamic_forces
+)
+{
+    omp_set_num_threads(options.NumCores);
+    uint n_surf = options.NumSurfaces;
+
+    UVLM::Types::VecDimensions dimensions;
+    UVLM::CppInterface::transform_dimensions(n_surf,
+                                             p_dimensions,
+                                             dimensions);
+    UVLM::Types::VecDimensions dimensions_star;
+    UVLM::CppInterface::transform_dimensions(n_surf,
+                                             p_dimensions_star,
+                                             dimensions_star);
+
+    UVLM::Types::VecVecMapX zeta;
+    UVLM::CppInterface::map_VecVecMat(dimensions,
+                                      p_zeta,
+                                      zeta,
+                                      1);
+
+    UVLM::Types::VecVecMapX zeta_dot;
+    UVLM::CppInterface::map_VecVecMat(dimensions,
+                                      p_zeta_dot,
+                                      zeta_dot,
+                                      1);
+
+    UVLM::Types::MapVectorX rbm_velocity (p_rbm_vel, 2*UVLM::Constants::NDIM);
+
+    UVLM::Types::VecVecMapX normals;
+    UVLM::CppInterface::map_VecVecMat(dimensions,
+                                      p_normals,
+                                      normals,
+                                      0);
+
+    std::vector<UVLM::Types::VecVecMapX> uext(n_cases);
+    std::vector<UVLM::Types::VecVecMapX> uext_star(n_cases);
+    std::vector<UVLM::Types::VecVecMapX> zeta_star(n_cases);
+    std::vector<UVLM::Types::VecMapX> gamma(n_cases);
+    std::vector<UVLM::Types::VecMapX> gamma_star(n_cases);
+    std::vector<UVLM::Types::VecVecMapX> forces(n_cases);
+    std::vector<UVLM::Types::VecVecMapX> dynamic_forces(n_cases);
+    for (uint i_case=0; i_case<n_cases; ++i_case)
+    {
+        UVLM::CppInterface::map_VecVecMat(dimensions,
+                                          p_uext[i_case],
+                                          uext[i_case],
+                                          1);
+        UVLM::CppInterface::map_VecVecMat(dimensions_star,
+                                          p_uext_star[i_case],
+                                          uext_star[i_case],
+                                          1);
+        UVLM::CppInterface::map_VecVecMat(dimensions_star,
+                                          p_zeta_star[i_case],
+                                          zeta_star[i_case],
+                                          1);
+        UVLM::CppInterface::map_VecMat(dimensions,
+                                       p_gamma[i_case],
+                                       gamma[i_case],
+                                       0);
+        UVLM::CppInterface::map_VecMat(dimensions_star,
+                                       p_gamma_star[i_case],
+                                       gamma_star[i_case],
+                                       0);
+        UVLM::CppInterface::map_VecVecMat(dimensions,
+                                          p_forces[i_case],
+                                          forces[i_case],
+                                          1,
+                                          2*UVLM::Constants::NDIM);
+        UVLM::CppInterface::map_VecVecMat(dimensions,
+                                          p_dynamic_forces[i_case],
+                                          dynamic_forces[i_case],
+                                          1,
+                                          2*UVLM::Constants::NDIM);
+    }
+
+    UVLM::Unsteady::ensemble_solver
+    (
+        i_iter,
+        zeta,
+        zeta_dot,
+        uext,
+        uext_star,
+        zeta_star,
+        gamma,
+        gamma_star,
+        normals,
+        rbm_velocity,
+        forces,
+        dynamic_forces,
+        options,
+        flightconditions
+    );
+}
+
 DLLEXPORT void calculate_unsteady_forces
 (
     const UVLM::Types::UVMopts& options,
@@ -516,24 +707,99 @@ DLLEXPORT void total_induced_velocity_at_points
                                    gamma_star,
                                    0);
 
-    #pragma omp parallel for
-    for (uint ipoint=0; ipoint<npoints; ipoint++)
+    const UVLM::Types::MirrorImages images = UVLM::Types::mirror_images(options);
+    UVLM::BiotSavart::SegmentTable segments;
+    for (uint i_surf=0; i_surf<n_surf; ++i_surf)
     {
-        UVLM::Types::Vector3 target_triad;
-        UVLM::Types::Vector3 aux_uout;
-        target_triad << target_triads(ipoint, 0),
-                        target_triads(ipoint, 1),
-                        target_triads(ipoint, 2);
-        aux_uout = UVLM::BiotSavart::total_induced_velocity_on_point(target_triad,
-                        zeta,
-                        zeta_star,
-                        gamma,
-                        gamma_star,
-                        options.ImageMethod);
-        uout(ipoint, 0) = aux_uout(0);
-        uout(ipoint, 1) = aux_uout(1);
-        uout(ipoint, 2) = aux_uout(2);
+        segments.add_surface(zeta[i_surf],
+                             zeta_star[i_surf],
+                             gamma[i_surf],
+                             gamma_star[i_surf]);
     }
+    if (options.morton_order) {segments.sort_morton();}
+
+    uout.setZero();
+    segments.induced_velocities(target_triads, uout, images);
+
+}
+
+DLLEXPORT void total_induced_velocity_and_gradient_at_points
+(
+    const UVLM::Types::UVMopts& options,
+    unsigned int** p_dimensions,
+    unsigned int** p_dimensions_star,
+    double** p_zeta,
+    double** p_zeta_star,
+    double** p_gamma,
+    double** p_gamma_star,
+    double* p_target_triads,
+    double* p_uout,
+    double* p_gradout,
+    unsigned int npoints
+)
+{
+    omp_set_num_threads(options.NumCores);
+    uint n_surf = options.NumSurfaces;
+    UVLM::Types::VecDimensions dimensions;
+    UVLM::CppInterface::transform_dimensions(n_surf,
+                                             p_dimensions,
+                                             dimensions);
+    UVLM::Types::VecDimensions dimensions_star;
+    UVLM::CppInterface::transform_dimensions(n_surf,
+                                             p_dimensions_star,
+                                             dimensions_star);
+
+    UVLM::Types::VecVecMapX zeta;
+    UVLM::CppInterface::map_VecVecMat(dimensions,
+                                      p_zeta,
+                                      zeta,
+                                      1);
+
+    UVLM::Types::VecVecMapX zeta_star;
+    UVLM::CppInterface::map_VecVecMat(dimensions_star,
+                                      p_zeta_star,
+                                      zeta_star,
+                                      1);
+
+    UVLM::Types::MapMatrixX uout(p_uout,
+                                 npoints,
+                                 UVLM::Constants::NDIM);
+
+    // velocity gradients, d u(i)/d x(j) in the column 3*i + j
+    UVLM::Types::MapMatrixX gradout(p_gradout,
+                                    npoints,
+                                    UVLM::Constants::NDIM*UVLM::Constants::NDIM);
+
+    UVLM::Types::MapMatrixX target_triads(p_target_triads,
+                                          npoints,
+                                          UVLM::Constants::NDIM);
+
+    UVLM::Types::VecMapX gamma;
+    UVLM::CppInterface::map_VecMat(dimensions,
+                                   p_gamma,
+                                   gamma,
+                                   0);
+
+    UVLM::Types::VecMapX gamma_star;
+    UVLM::CppInterface::map_VecMat(dimensions_star,
+                                   p_gamma_star,
+                                   gamma_star,
+                                   0);
+
+    const UVLM::Types::MirrorImages images = UVLM::Types::mirror_images(options);
+    UVLM::BiotSavart::SegmentTable segments;
+    for (uint i_surf=0; i_surf<n_surf; ++i_surf)
+    {
+        segments.add_surface(zeta[i_surf],
+                             zeta_star[i_surf],
+                             gamma[i_surf],
+                             gamma_star[i_surf]);
+    }
+    if (options.morton_order) {segments.sort_morton();}
+
+    uout.setZero();
+    gradout.setZero();
+    segments.induced_velocities_and_gradients(target_triads, uout, gradout, images);
 
 }
 
@@ -764,12 +1030,26 @@ DLLEXPORT void multisurface
         gamma[0],
         target_surface_col[0],
         uout[0],
-        options.ImageMethod,
+        UVLM::Types::mirror_images(options),
         normal[0]
     );
 }
 
 
+DLLEXPORT void get_solver_statistics
+(
+    UVLM::Types::SolverStatistics& statistics
+)
+{
+    statistics = UVLM::LinearSolver::session().statistics;
+}
+
+DLLEXPORT void reset_solver_session()
+{
+    UVLM::LinearSolver::session().reset();
+}
+
+
 // linear UVLM interface
 
 DLLEXPORT void call_der_biot_panel(double p_DerP[9],